@@ -1,13 +1,25 @@
 import argparse
 import gzip
 import io  # noqa: F401 used in timeit strings
+import json
+import sys
+import time
 import timeit
-import zlib
+from concurrent.futures import ThreadPoolExecutor
 from pathlib import Path
-from typing import Dict
+from typing import Any, Callable, Dict, List
 
 from isal import igzip, isal_zlib  # noqa: F401 used in timeit strings
 
+try:
+    import resource
+except ImportError:  # resource is not available on Windows.
+    resource = None  # type: ignore
+
+# Machine-readable results, written out with --json so regressions can be
+# tracked between runs.
+RESULTS: List[Dict[str, Any]] = []
+
 DATA_DIR = Path(__file__).parent / "tests" / "data"
 COMPRESSED_FILE = DATA_DIR / "test.fastq.gz"
 with gzip.open(str(COMPRESSED_FILE), mode="rb") as file_h:
@@ -61,7 +73,7 @@ def benchmark(name: str,
               **kwargs):
     print(name)
     print("name\tisal\tzlib\tratio")
-    for name, data_block in names_and_data.items():
+    for size_name, data_block in names_and_data.items():
         timeit_kwargs = dict(globals=dict(**globals(), **locals()),
                              number=number, **kwargs)
         isal_time = timeit.timeit(isal_string, **timeit_kwargs)
@@ -69,14 +81,126 @@ def benchmark(name: str,
         isal_microsecs = round(isal_time * (1_000_000 / number), 2)
         zlib_microsecs = round(zlib_time * (1_000_000 / number), 2)
         ratio = round(isal_time / zlib_time, 2)
-        print("{0}\t{1}\t{2}\t{3}".format(name,
+        print("{0}\t{1}\t{2}\t{3}".format(size_name,
                                           isal_microsecs,
                                           zlib_microsecs,
                                           ratio))
+        RESULTS.append(dict(suite=name, size=size_name,
+                            isal_microseconds=isal_microsecs,
+                            zlib_microseconds=zlib_microsecs,
+                            ratio=ratio))
 
 
 # show_sizes()
 
+
+def large_data(target_size: int) -> bytes:
+    """Repeat the test data until it is at least target_size long."""
+    repeats = -(-target_size // len(data))  # ceiling division
+    return (data * repeats)[:target_size]
+
+
+def peak_rss() -> int:
+    """The peak resident set size of this process in bytes, or 0 when it
+    can not be determined."""
+    if resource is None:
+        return 0
+    max_rss = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    if sys.platform == "darwin":  # ru_maxrss is in bytes on macOS
+        return max_rss
+    return max_rss * 1024
+
+
+def throughput(suite: str,
+               name: str,
+               func: Callable[[], Any],
+               total_bytes: int,
+               repeats: int = 3) -> float:
+    """Run func repeats times and report the throughput of the best run
+    in gigabytes per second."""
+    best = min(timeit.repeat(func, number=1, repeat=repeats))
+    gb_per_second = total_bytes / best / 1_000_000_000
+    print("{0}\t{1}\t{2} GB/s".format(name, round(best, 4),
+                                      round(gb_per_second, 3)))
+    RESULTS.append(dict(suite=suite, name=name, seconds=best,
+                        bytes=total_bytes, gb_per_second=gb_per_second))
+    return best
+
+
+def benchmark_throughput(data_size: int, level: int = 1):
+    """Throughput of the one-shot and streaming paths on a realistically
+    sized buffer."""
+    block = large_data(data_size)
+    compressed = igzip.compress(block, level)
+    print("Throughput ({0} bytes, level {1})".format(len(block), level))
+    print("name\tseconds\tthroughput")
+    throughput("throughput", "igzip.compress (one-shot)",
+               lambda: igzip.compress(block, level), len(block))
+    throughput("throughput", "igzip.decompress (one-shot)",
+               lambda: igzip.decompress(compressed), len(block))
+
+    def compress_streaming():
+        compressobj = isal_zlib.compressobj(level, wbits=31)
+        for i in range(0, len(block), 256 * 1024):
+            compressobj.compress(block[i: i + 256 * 1024])
+        compressobj.flush()
+
+    throughput("throughput", "Compress.compress (streaming)",
+               compress_streaming, len(block))
+
+    def read_streaming():
+        with igzip.open(io.BytesIO(compressed), "rb") as reader:
+            while reader.read(128 * 1024):
+                pass
+
+    throughput("throughput", "igzip reader (streaming)",
+               read_streaming, len(block))
+    print("peak RSS: {0} MB".format(round(peak_rss() / (1024 * 1024), 1)))
+
+
+def benchmark_scaling(data_size: int, max_threads: int, level: int = 1):
+    """Multi-threaded compression scaling. Every thread compresses its
+    own slice with its own compressobj, which is the pattern enabled by
+    the nogil blocks around the ISA-L calls."""
+    block = large_data(data_size)
+    block_size = 1024 * 1024
+    blocks = [block[i:i + block_size]
+              for i in range(0, len(block), block_size)]
+
+    def compress_one(data_block: bytes) -> int:
+        compressobj = isal_zlib.compressobj(level, wbits=-15)
+        return len(compressobj.compress(data_block) + compressobj.flush())
+
+    print("Thread scaling ({0} bytes, level {1})".format(len(block), level))
+    print("threads\tseconds\tthroughput\tspeedup")
+    single_thread_time = None
+    for thread_count in range(1, max_threads + 1):
+        with ThreadPoolExecutor(max_workers=thread_count) as executor:
+            start = time.perf_counter()
+            list(executor.map(compress_one, blocks))
+            elapsed = time.perf_counter() - start
+        if single_thread_time is None:
+            single_thread_time = elapsed
+        speedup = single_thread_time / elapsed
+        gb_per_second = len(block) / elapsed / 1_000_000_000
+        print("{0}\t{1}\t{2} GB/s\t{3}".format(
+            thread_count, round(elapsed, 4), round(gb_per_second, 3),
+            round(speedup, 2)))
+        RESULTS.append(dict(suite="scaling", threads=thread_count,
+                            seconds=elapsed, bytes=len(block),
+                            gb_per_second=gb_per_second, speedup=speedup))
+
+
+def write_json(filename: str):
+    report = dict(
+        python_version=sys.version,
+        platform=sys.platform,
+        peak_rss=peak_rss(),
+        results=RESULTS,
+    )
+    Path(filename).write_text(json.dumps(report, indent=2))
+
+
 def argument_parser() -> argparse.ArgumentParser:
     parser = argparse.ArgumentParser()
     parser.add_argument("--all", action="store_true")
@@ -85,6 +209,16 @@ def argument_parser() -> argparse.ArgumentParser:
     parser.add_argument("--gzip", action="store_true")
     parser.add_argument("--sizes", action="store_true")
     parser.add_argument("--objects", action="store_true")
+    parser.add_argument("--throughput", action="store_true")
+    parser.add_argument("--scaling", action="store_true")
+    parser.add_argument("--data-size", type=int, default=128 * 1024 * 1024,
+                        help="Buffer size for the throughput and scaling "
+                             "suites. Default: 128 MiB.")
+    parser.add_argument("--max-threads", type=int, default=8,
+                        help="Maximum number of threads in the scaling "
+                             "suite. Default: 8.")
+    parser.add_argument("--json", metavar="FILE",
+                        help="Write the results as JSON to FILE.")
     return parser
 
 
@@ -130,3 +264,9 @@ if __name__ == "__main__":
                   "a = gzip.GzipFile(fileobj=io.BytesIO(), mode='rb')")
     if args.sizes or args.all:
         show_sizes()
+    if args.throughput or args.all:
+        benchmark_throughput(args.data_size)
+    if args.scaling or args.all:
+        benchmark_scaling(args.data_size, args.max_threads)
+    if args.json:
+        write_json(args.json)
@@ -145,8 +145,15 @@ def build_isa_l(compiler_command: str, compiler_options: str):
     build_env = os.environ.copy()
     # Add -fPIC flag to allow static compilation
     build_env["CC"] = compiler_command
+    # Extra compiler flags can be passed to the ISA-L build, for example
+    # to enable the newest AVX-512 igzip code paths with a capable
+    # toolchain: PYTHON_ISAL_EXTRA_CFLAGS="-march=skylake-avx512".
+    # ISA-L still dispatches at runtime, so the resulting binary stays
+    # safe on older CPUs.
+    extra_cflags = os.environ.get("PYTHON_ISAL_EXTRA_CFLAGS", "")
     if SYSTEM_IS_UNIX:
-        build_env["CFLAGS"] = compiler_options + " -fPIC"
+        build_env["CFLAGS"] = (compiler_options + " -fPIC " +
+                               extra_cflags).strip()
     elif SYSTEM_IS_WINDOWS:
         # The nmake file has CLFAGS_REL for all the compiler options.
         # This is added to CFLAGS with all the necessary include options.
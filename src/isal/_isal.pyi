@@ -18,7 +18,12 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
+from typing import Any, Dict
+
 ISAL_MAJOR_VERSION: int
 ISAL_MINOR_VERSION: int
 ISAL_PATCH_VERSION: int
 ISAL_VERSION: str
+
+def cpu_features() -> Dict[str, bool]: ...
+def dispatch_info() -> Dict[str, Any]: ...
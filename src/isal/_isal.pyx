@@ -18,6 +18,8 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
+import platform
+
 from .version cimport ISAL_MAJOR_VERSION as C_ISAL_MAJOR_VERSION
 from .version cimport ISAL_MINOR_VERSION as C_ISAL_MINOR_VERSION
 from .version cimport ISAL_PATCH_VERSION as C_ISAL_PATCH_VERSION
@@ -26,3 +28,101 @@ ISAL_MINOR_VERSION = C_ISAL_MINOR_VERSION
 ISAL_PATCH_VERSION = C_ISAL_PATCH_VERSION
 ISAL_VERSION = "{0}.{1}.{2}".format(ISAL_MAJOR_VERSION, ISAL_MINOR_VERSION,
                                     ISAL_PATCH_VERSION)
+
+# ISA-L's runtime dispatcher does not expose which kernel variants it
+# selected, but on x86 it keys purely on CPU features. The same features
+# are detected here so deployments can assert they are not falling back
+# to baseline code inside a container or VM.
+cdef extern from *:
+    """
+    #if defined(__x86_64__) || defined(__i386__)
+    #define ISAL_PY_IS_X86 1
+    static int isal_py_cpu_sse42(void)
+        {__builtin_cpu_init(); return __builtin_cpu_supports("sse4.2");}
+    static int isal_py_cpu_pclmul(void)
+        {__builtin_cpu_init(); return __builtin_cpu_supports("pclmul");}
+    static int isal_py_cpu_avx(void)
+        {__builtin_cpu_init(); return __builtin_cpu_supports("avx");}
+    static int isal_py_cpu_avx2(void)
+        {__builtin_cpu_init(); return __builtin_cpu_supports("avx2");}
+    static int isal_py_cpu_avx512f(void)
+        {__builtin_cpu_init(); return __builtin_cpu_supports("avx512f");}
+    static int isal_py_cpu_avx512cd(void)
+        {__builtin_cpu_init(); return __builtin_cpu_supports("avx512cd");}
+    static int isal_py_cpu_avx512bw(void)
+        {__builtin_cpu_init(); return __builtin_cpu_supports("avx512bw");}
+    static int isal_py_cpu_avx512vl(void)
+        {__builtin_cpu_init(); return __builtin_cpu_supports("avx512vl");}
+    #else
+    #define ISAL_PY_IS_X86 0
+    static int isal_py_cpu_sse42(void) {return 0;}
+    static int isal_py_cpu_pclmul(void) {return 0;}
+    static int isal_py_cpu_avx(void) {return 0;}
+    static int isal_py_cpu_avx2(void) {return 0;}
+    static int isal_py_cpu_avx512f(void) {return 0;}
+    static int isal_py_cpu_avx512cd(void) {return 0;}
+    static int isal_py_cpu_avx512bw(void) {return 0;}
+    static int isal_py_cpu_avx512vl(void) {return 0;}
+    #endif
+    """
+    int ISAL_PY_IS_X86
+    int isal_py_cpu_sse42()
+    int isal_py_cpu_pclmul()
+    int isal_py_cpu_avx()
+    int isal_py_cpu_avx2()
+    int isal_py_cpu_avx512f()
+    int isal_py_cpu_avx512cd()
+    int isal_py_cpu_avx512bw()
+    int isal_py_cpu_avx512vl()
+
+
+def cpu_features():
+    """Return a dict of the CPU features that ISA-L's x86 runtime
+    dispatcher selects its kernels on. On non-x86 architectures all
+    features read False.
+
+    This module is only built on Unix-like systems (the version header
+    it needs is not generated by the Windows build), so no feature
+    introspection is available on Windows."""
+    return {
+        "sse4.2": bool(isal_py_cpu_sse42()),
+        "pclmul": bool(isal_py_cpu_pclmul()),
+        "avx": bool(isal_py_cpu_avx()),
+        "avx2": bool(isal_py_cpu_avx2()),
+        "avx512f": bool(isal_py_cpu_avx512f()),
+        "avx512cd": bool(isal_py_cpu_avx512cd()),
+        "avx512bw": bool(isal_py_cpu_avx512bw()),
+        "avx512vl": bool(isal_py_cpu_avx512vl()),
+    }
+
+
+def dispatch_info():
+    """Return a dict describing which instruction set level ISA-L's
+    dispatcher will use on this host: the architecture, the detected CPU
+    features, and best_isa, the highest tier available. A deployment that
+    expects modern hardware can assert best_isa is not "base".
+
+    This module is only built on Unix-like systems, see cpu_features."""
+    features = cpu_features()
+    if not ISAL_PY_IS_X86:
+        # Non-x86 (such as aarch64) builds dispatch on other mechanisms.
+        best_isa = "unknown"
+    # The AVX-512 tier in ISA-L's dispatcher requires the F/CD/BW/VL
+    # subsets.
+    elif (features["avx512f"] and features["avx512cd"] and
+            features["avx512bw"] and features["avx512vl"]):
+        best_isa = "avx512"
+    elif features["avx2"]:
+        best_isa = "avx2"
+    elif features["avx"]:
+        best_isa = "avx"
+    elif features["sse4.2"]:
+        best_isa = "sse4.2"
+    else:
+        best_isa = "base"
+    return {
+        "architecture": platform.machine(),
+        "isal_version": ISAL_VERSION,
+        "features": features,
+        "best_isa": best_isa,
+    }
@@ -0,0 +1,344 @@
+# Copyright (c) 2020 Leiden University Medical Center
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Reading and writing of BGZF (blocked gzip) files as used by BAM, VCF
+and other genomics formats. BGZF files are gzip files consisting of
+members of at most 64 KiB with the block length recorded in a BC extra
+field, which makes the blocks independently decompressible. The blocks
+are (de)compressed on a thread pool, and the reader supports seeking to
+BGZF virtual offsets."""
+
+import io
+import struct
+from collections import deque
+from concurrent.futures import ThreadPoolExecutor
+
+from . import igzip_lib
+from .igzip import BadGzipFile
+
+__all__ = ["BGZFError", "BGZFReader", "BGZFWriter", "open",
+           "make_virtual_offset", "split_virtual_offset", "BGZF_EOF"]
+
+#: A BGZF block is at most 65536 bytes in total. Limiting the input per
+#: block to 65280 bytes guarantees the block fits even when deflate
+#: expands the data, following the BAM specification.
+MAX_BLOCK_DATA_SIZE = 65280
+
+_BLOCK_HEADER_STRUCT = struct.Struct("<BBBBIBBHBBHH")
+
+#: The fixed empty block that marks the end of a BGZF file.
+BGZF_EOF = (b"\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00\x42\x43"
+            b"\x02\x00\x1b\x00\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00")
+
+
+class BGZFError(BadGzipFile):
+    """Exception raised for invalid BGZF blocks."""
+
+
+def make_virtual_offset(block_offset, within_block_offset):
+    """Combine the compressed offset of a block and an offset inside its
+    decompressed data into a BGZF virtual offset."""
+    if not 0 <= within_block_offset < 2 ** 16:
+        raise ValueError("within_block_offset should fit in 16 bits")
+    if not 0 <= block_offset < 2 ** 48:
+        raise ValueError("block_offset should fit in 48 bits")
+    return (block_offset << 16) | within_block_offset
+
+
+def split_virtual_offset(virtual_offset):
+    """Split a BGZF virtual offset into (block_offset,
+    within_block_offset)."""
+    return virtual_offset >> 16, virtual_offset & 0xFFFF
+
+
+def open(filename, mode="rb", compresslevel=igzip_lib.ISAL_DEFAULT_COMPRESSION,
+         threads=1):
+    """Open a BGZF file for reading ("r"/"rb") or writing ("w"/"wb").
+
+    :param filename: A filename or a binary file object.
+    :param compresslevel: Compression level from 0 to 3, used when
+                          writing.
+    :param threads: Number of threads used to (de)compress blocks.
+    """
+    if mode not in ("r", "rb", "w", "wb", "x", "xb", "a", "ab"):
+        raise ValueError("Invalid mode: {!r}".format(mode))
+    binary_mode = mode if "b" in mode else mode + "b"
+    if isinstance(filename, (str, bytes)) or hasattr(filename, "__fspath__"):
+        binary_file = io.open(filename, binary_mode)
+        closefd = True
+    elif hasattr(filename, "read") or hasattr(filename, "write"):
+        binary_file = filename
+        closefd = False
+    else:
+        raise TypeError("filename must be a str or bytes object, or a file")
+    if "r" in binary_mode:
+        return BGZFReader(binary_file, threads=threads, closefd=closefd)
+    return BGZFWriter(binary_file, compresslevel, threads=threads,
+                      closefd=closefd)
+
+
+def _compress_block(data, compresslevel):
+    """Compress *data* into one complete BGZF block."""
+    compressed = igzip_lib.compress(data, compresslevel,
+                                    flag=igzip_lib.COMP_GZIP_NO_HDR)
+    # Total block size: 18 bytes header, deflate data, 8 bytes trailer.
+    bsize = len(compressed) + _BLOCK_HEADER_STRUCT.size - 1
+    if bsize >= 2 ** 16:
+        raise BGZFError("Compressed block exceeds the BGZF block limit")
+    header = _BLOCK_HEADER_STRUCT.pack(
+        0x1f, 0x8b, 8, 4,  # magic, deflate method, FEXTRA flag
+        0, 0, 0xff,  # mtime, xfl, unknown OS
+        6, 66, 67, 2,  # xlen, 'B', 'C', subfield length
+        bsize)
+    return header + compressed
+
+
+def _decompress_block(block):
+    """Decompress the deflate data and trailer of a BGZF block, verifying
+    the crc32 and length in the trailer."""
+    isize = int.from_bytes(block[-4:], "little", signed=False)
+    return igzip_lib.decompress(block, igzip_lib.DECOMP_GZIP_NO_HDR_VER,
+                                bufsize=isize + 1)
+
+
+class BGZFWriter(io.RawIOBase):
+    """Write a BGZF file. Input data is cut into blocks of *block_size*
+    bytes which are compressed on *threads* worker threads and written in
+    order. close() appends the BGZF end-of-file marker."""
+
+    def __init__(self, fp, compresslevel=igzip_lib.ISAL_DEFAULT_COMPRESSION,
+                 threads=1, block_size=MAX_BLOCK_DATA_SIZE,
+                 closefd=False):
+        if not (0 <= compresslevel <= 3):
+            raise ValueError(
+                "Compression level should be between 0 and 3.")
+        if threads < 1:
+            raise ValueError("threads should be at least 1")
+        if not 0 < block_size <= MAX_BLOCK_DATA_SIZE:
+            raise ValueError("block_size should be between 1 and {0}".format(
+                MAX_BLOCK_DATA_SIZE))
+        self.raw = fp
+        self.closefd = closefd
+        self.compresslevel = compresslevel
+        self.block_size = block_size
+        self._buffer = bytearray()
+        self._executor = ThreadPoolExecutor(max_workers=threads)
+        self._futures = deque()
+        self._max_futures = threads + 2
+
+    def writable(self) -> bool:
+        return True
+
+    def _write_finished_blocks(self, max_pending):
+        while len(self._futures) > max_pending:
+            self.raw.write(self._futures.popleft().result())
+
+    def _submit_block(self, data):
+        self._futures.append(
+            self._executor.submit(_compress_block, data,
+                                  self.compresslevel))
+        self._write_finished_blocks(self._max_futures)
+
+    def write(self, b) -> int:
+        if self.closed:
+            raise ValueError("write() on closed BGZFWriter")
+        with memoryview(b) as view:
+            length = view.nbytes
+            self._buffer.extend(view)
+        while len(self._buffer) >= self.block_size:
+            self._submit_block(bytes(self._buffer[:self.block_size]))
+            del self._buffer[:self.block_size]
+        return length
+
+    def flush(self):
+        if self.closed:
+            raise ValueError("flush() on closed BGZFWriter")
+        # A partial block is written out; BGZF blocks are independent so
+        # this only (slightly) affects the compression ratio.
+        if self._buffer:
+            self._submit_block(bytes(self._buffer))
+            self._buffer.clear()
+        self._write_finished_blocks(0)
+        self.raw.flush()
+
+    def close(self):
+        if self.closed:
+            return
+        try:
+            self.flush()
+            self.raw.write(BGZF_EOF)
+            self.raw.flush()
+        finally:
+            self._executor.shutdown()
+            super().close()
+            if self.closefd:
+                self.raw.close()
+
+
+class BGZFReader(io.RawIOBase):
+    """Read a BGZF file. The BC extra field of each block is used to
+    slice the compressed stream into blocks without decompressing, and
+    the blocks are decompressed in parallel on *threads* worker threads
+    while being delivered in order.
+
+    tell() and seek() use BGZF virtual offsets: the compressed offset of
+    a block in the upper 48 bits and the offset into its decompressed
+    data in the lower 16 bits.
+    """
+
+    def __init__(self, fp, threads=1, queue_size=0, closefd=False):
+        if threads < 1:
+            raise ValueError("threads should be at least 1")
+        self.raw = fp
+        self.closefd = closefd
+        self._executor = ThreadPoolExecutor(max_workers=threads)
+        self._queue_size = queue_size if queue_size > 0 else threads + 2
+        self._futures = deque()  # of (block_offset, future)
+        self._next_block_offset = 0
+        self._file_ended = False
+        self._block_offset = 0
+        self._current = memoryview(b"")
+        self._current_pos = 0
+
+    def readable(self) -> bool:
+        return True
+
+    def _read_exact(self, length):
+        data = self.raw.read(length)
+        while len(data) < length:
+            more = self.raw.read(length - len(data))
+            if not more:
+                raise BGZFError("Truncated BGZF block")
+            data += more
+        return data
+
+    def _read_raw_block(self):
+        """Read the next block from the file. Returns (block_offset,
+        deflate data and trailer) or None at end of file."""
+        head = self.raw.read(12)
+        if len(head) == 0:
+            return None
+        if len(head) < 12:
+            raise BGZFError("Truncated BGZF block")
+        magic, method, flags, mtime, xfl, os_byte, xlen = struct.unpack(
+            "<HBBIBBH", head)
+        if magic != 0x8b1f:
+            raise BGZFError("Not a gzipped file ({!r})".format(head[:2]))
+        if method != 8:
+            raise BGZFError("Unknown compression method")
+        if not flags & 4:  # FEXTRA
+            raise BGZFError(
+                "Not a BGZF file: gzip header misses the extra field")
+        extra = self._read_exact(xlen)
+        bsize = None
+        pos = 0
+        while pos + 4 <= xlen:
+            subfield_id1, subfield_id2, subfield_length = struct.unpack_from(
+                "<BBH", extra, pos)
+            if (subfield_id1, subfield_id2, subfield_length) == (66, 67, 2):
+                bsize = struct.unpack_from("<H", extra, pos + 4)[0]
+            pos += 4 + subfield_length
+        if bsize is None:
+            raise BGZFError("Not a BGZF file: BC subfield missing")
+        remainder_length = bsize + 1 - 12 - xlen
+        if remainder_length < 8:
+            raise BGZFError("Invalid BSIZE field")
+        block = self._read_exact(remainder_length)
+        block_offset = self._next_block_offset
+        self._next_block_offset += bsize + 1
+        return block_offset, block
+
+    def _fill_queue(self):
+        while not self._file_ended and len(self._futures) < self._queue_size:
+            raw_block = self._read_raw_block()
+            if raw_block is None:
+                self._file_ended = True
+                break
+            block_offset, block = raw_block
+            self._futures.append(
+                (block_offset,
+                 self._executor.submit(_decompress_block, block)))
+
+    def _advance(self):
+        """Load the next non-empty decompressed block. Returns False at
+        end of file."""
+        while True:
+            self._fill_queue()
+            if not self._futures:
+                return False
+            self._block_offset, future = self._futures.popleft()
+            data = future.result()
+            if data:
+                self._current = memoryview(data)
+                self._current_pos = 0
+                return True
+            # Empty blocks (such as the EOF marker) are skipped.
+
+    def readinto(self, b) -> int:
+        # Fills across block boundaries, so read(n) is not cut short at
+        # the end of each 64 KiB block.
+        with memoryview(b) as view:
+            total = 0
+            while total < view.nbytes:
+                if self._current_pos == len(self._current):
+                    if not self._advance():
+                        break
+                length = min(view.nbytes - total,
+                             len(self._current) - self._current_pos)
+                view[total:total + length] = self._current[
+                    self._current_pos:self._current_pos + length]
+                self._current_pos += length
+                total += length
+            return total
+
+    def tell(self):
+        """The virtual offset of the current position."""
+        return make_virtual_offset(self._block_offset, self._current_pos)
+
+    def seek(self, virtual_offset, whence=io.SEEK_SET):
+        """Move to the position described by a BGZF *virtual_offset*, as
+        previously returned by tell()."""
+        if whence != io.SEEK_SET:
+            raise ValueError("BGZF files can only seek to virtual offsets")
+        block_offset, within_block_offset = split_virtual_offset(
+            virtual_offset)
+        # Discard the readahead and restart at the requested block.
+        self._futures.clear()
+        self._file_ended = False
+        self.raw.seek(block_offset)
+        self._next_block_offset = block_offset
+        self._current = memoryview(b"")
+        self._current_pos = 0
+        if not self._advance():
+            raise BGZFError("Virtual offset points beyond end of file")
+        if within_block_offset > len(self._current):
+            raise BGZFError(
+                "Virtual offset points beyond the end of the block")
+        self._current_pos = within_block_offset
+        return virtual_offset
+
+    def close(self):
+        if self.closed:
+            return
+        self._current = memoryview(b"")
+        self._executor.shutdown()
+        super().close()
+        if self.closefd:
+            self.raw.close()
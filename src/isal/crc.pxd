@@ -23,4 +23,89 @@ cdef extern from "<isa-l/crc.h>":
     unsigned int init_crc,          #!< initial CRC value, 32 bits
     const unsigned char *buf, #!< buffer to calculate CRC on
     unsigned long long len                #!< buffer length in bytes (64-bit data)
-    )
+    ) nogil
+
+############################
+# python-isal functions
+############################
+
+# Checksum combination as implemented in zlib's crc32_combine and
+# adler32_combine. ISA-L itself does not provide combine primitives, so the
+# matrix trick over GF(2) is implemented here. These functions allow
+# calculating the checksum of a concatenation from the checksums of the
+# parts.
+
+cdef inline unsigned long gf2_matrix_times(unsigned long *mat,
+                                           unsigned long vec) nogil:
+    cdef unsigned long summed = 0
+    while vec:
+        if vec & 1:
+            summed ^= mat[0]
+        vec >>= 1
+        mat += 1
+    return summed
+
+
+cdef inline void gf2_matrix_square(unsigned long *square,
+                                   unsigned long *mat) nogil:
+    cdef int n
+    for n in range(32):
+        square[n] = gf2_matrix_times(mat, mat[n])
+
+
+cdef inline unsigned int crc32_comb(unsigned int crc1,
+                                    unsigned int crc2,
+                                    unsigned long long len2) nogil:
+    cdef int n
+    cdef unsigned long row
+    cdef unsigned long crc = crc1
+    cdef unsigned long even[32]  # even-power-of-two zero operator
+    cdef unsigned long odd[32]  # odd-power-of-two zero operator
+    # Degenerate case, the crc of an empty block is a no-op.
+    if len2 == 0:
+        return crc1
+    # Put operator for one zero bit in odd.
+    odd[0] = 0xedb88320  # CRC-32 polynomial, reflected
+    row = 1
+    for n in range(1, 32):
+        odd[n] = row
+        row <<= 1
+    # Put operator for two zero bits in even and four zero bits in odd.
+    gf2_matrix_square(even, odd)
+    gf2_matrix_square(odd, even)
+    # Apply len2 zeroes to crc1 by applying the operators for each
+    # power of two for which len2 has a bit set.
+    while True:
+        gf2_matrix_square(even, odd)
+        if len2 & 1:
+            crc = gf2_matrix_times(even, crc)
+        len2 >>= 1
+        if len2 == 0:
+            break
+        gf2_matrix_square(odd, even)
+        if len2 & 1:
+            crc = gf2_matrix_times(odd, crc)
+        len2 >>= 1
+        if len2 == 0:
+            break
+    return <unsigned int>(crc ^ crc2)
+
+
+cdef inline unsigned int adler32_comb(unsigned int adler1,
+                                      unsigned int adler2,
+                                      unsigned long long len2) nogil:
+    cdef unsigned long BASE = 65521  # largest prime smaller than 65536
+    cdef unsigned long rem = len2 % BASE
+    cdef unsigned long sum1 = adler1 & 0xffff
+    cdef unsigned long sum2 = (rem * sum1) % BASE
+    sum1 += (adler2 & 0xffff) + BASE - 1
+    sum2 += ((adler1 >> 16) & 0xffff) + ((adler2 >> 16) & 0xffff) + BASE - rem
+    if sum1 >= BASE:
+        sum1 -= BASE
+    if sum1 >= BASE:
+        sum1 -= BASE
+    if sum2 >= (BASE << 1):
+        sum2 -= BASE << 1
+    if sum2 >= BASE:
+        sum2 -= BASE
+    return <unsigned int>(sum1 | (sum2 << 16))
@@ -24,9 +24,12 @@ Library to speed up its methods."""
 import argparse
 import gzip
 import io
+import mmap
 import os
+import queue
 import struct
 import sys
+import threading
 import time
 from typing import List, Optional, SupportsInt
 import _compression  # noqa: I201  # Not third-party
@@ -41,6 +44,11 @@ _COMPRESS_LEVEL_BEST = isal_zlib.ISAL_BEST_COMPRESSION
 
 FTEXT, FHCRC, FEXTRA, FNAME, FCOMMENT = 1, 2, 4, 8, 16
 
+# Amount of compressed data read in one C call in the read loop. Larger
+# values reduce the amount of Python interaction, 128K keeps the buffers
+# well within L2 cache size.
+READ_BUFFER_SIZE = 128 * 1024
+
 try:
     BadGzipFile = gzip.BadGzipFile  # type: ignore
 except AttributeError:  # Versions lower than 3.8 do not have BadGzipFile
@@ -49,7 +57,8 @@ except AttributeError:  # Versions lower than 3.8 do not have BadGzipFile
 
 # The open method was copied from the CPython source with minor adjustments.
 def open(filename, mode="rb", compresslevel=_COMPRESS_LEVEL_TRADEOFF,
-         encoding=None, errors=None, newline=None):
+         encoding=None, errors=None, newline=None, *, use_mmap=False,
+         readahead=False):
     """Open a gzip-compressed file in binary or text mode. This uses the isa-l
     library for optimized speed.
 
@@ -68,6 +77,15 @@ def open(filename, mode="rb", compresslevel=_COMPRESS_LEVEL_TRADEOFF,
     io.TextIOWrapper instance with the specified encoding, error handling
     behavior, and line ending(s).
 
+    When use_mmap is true the file is memory-mapped and the decompressor is
+    fed directly from the mapping, so no compressed bytes are copied into
+    intermediate buffers. This is only supported for reading and improves
+    page-cache behavior on repeated scans of the same file.
+
+    When readahead is true a helper thread keeps compressed chunks
+    prefetched ahead of the consumer, overlapping file I/O with
+    decompression. This is only supported for reading and helps most when
+    the input comes from slow or high-latency storage.
     """
     if "t" in mode:
         if "b" in mode:
@@ -82,8 +100,36 @@ def open(filename, mode="rb", compresslevel=_COMPRESS_LEVEL_TRADEOFF,
             raise ValueError("Argument 'newline' not supported in binary mode")
 
     gz_mode = mode.replace("t", "")
+    if use_mmap and readahead:
+        raise ValueError(
+            "use_mmap and readahead can not be combined")
+    if use_mmap:
+        if "r" not in gz_mode:
+            raise ValueError("use_mmap is only supported for reading")
+        mmap_file = _MemoryMappedFile(filename)
+        binary_file = IGzipFile(None, gz_mode, compresslevel, mmap_file)
+        # Let IGzipFile.close() close the mapping, analogous to the file
+        # objects GzipFile opens itself.
+        binary_file.myfileobj = mmap_file
+    elif readahead:
+        if "r" not in gz_mode:
+            raise ValueError("readahead is only supported for reading")
+        if isinstance(filename, (str, bytes)) or hasattr(filename,
+                                                         "__fspath__"):
+            raw = io.open(filename, "rb")
+            readahead_file = _ReadaheadFile(raw, closefd=True)
+        elif hasattr(filename, "read"):
+            readahead_file = _ReadaheadFile(filename)
+        else:
+            raise TypeError(
+                "filename must be a str or bytes object, or a file")
+        binary_file = IGzipFile(None, gz_mode, compresslevel,
+                                readahead_file)
+        # Let IGzipFile.close() stop the prefetch thread (and close the
+        # file when it was opened here).
+        binary_file.myfileobj = readahead_file
     # __fspath__ method is os.PathLike
-    if isinstance(filename, (str, bytes)) or hasattr(filename, "__fspath__"):
+    elif isinstance(filename, (str, bytes)) or hasattr(filename, "__fspath__"):
         binary_file = IGzipFile(filename, gz_mode, compresslevel)
     elif hasattr(filename, "read") or hasattr(filename, "write"):
         binary_file = IGzipFile(None, gz_mode, compresslevel, filename)
@@ -96,6 +142,181 @@ def open(filename, mode="rb", compresslevel=_COMPRESS_LEVEL_TRADEOFF,
         return binary_file
 
 
+class _MemoryMappedFile(io.RawIOBase):
+    """A read-only binary file object over a memory-mapped file. read()
+    returns memoryview slices of the mapping, so the compressed data
+    reaches the decompressor without being copied."""
+
+    def __init__(self, filename):
+        if isinstance(filename, (str, bytes)) or hasattr(filename,
+                                                         "__fspath__"):
+            with io.open(filename, "rb") as binary_file:
+                self._init_mmap(binary_file)
+        elif hasattr(filename, "fileno"):
+            self._init_mmap(filename)
+        else:
+            raise TypeError("filename must be a str or bytes object, or a "
+                            "file with a file descriptor")
+        self._pos = 0
+
+    def _init_mmap(self, binary_file):
+        if os.fstat(binary_file.fileno()).st_size == 0:
+            # Empty files can not be memory-mapped.
+            self._mmap = None
+            self._view = memoryview(b"")
+            return
+        self._mmap = mmap.mmap(binary_file.fileno(), 0,
+                               access=mmap.ACCESS_READ)
+        self._view = memoryview(self._mmap)
+
+    def readable(self) -> bool:
+        return True
+
+    def seekable(self) -> bool:
+        return True
+
+    def read(self, size=-1):
+        if size is None or size < 0:
+            result = self._view[self._pos:]
+        else:
+            result = self._view[self._pos:self._pos + size]
+        self._pos += len(result)
+        return result
+
+    def seek(self, offset, whence=io.SEEK_SET):
+        if whence == io.SEEK_SET:
+            new_pos = offset
+        elif whence == io.SEEK_CUR:
+            new_pos = self._pos + offset
+        elif whence == io.SEEK_END:
+            new_pos = len(self._view) + offset
+        else:
+            raise ValueError("Invalid value for whence: {}".format(whence))
+        if new_pos < 0:
+            raise ValueError("Negative seek position {}".format(new_pos))
+        self._pos = min(new_pos, len(self._view))
+        return self._pos
+
+    def tell(self):
+        return self._pos
+
+    def close(self):
+        if self.closed:
+            return
+        self._view.release()
+        self._view = memoryview(b"")
+        if self._mmap is not None:
+            try:
+                self._mmap.close()
+            except BufferError:
+                # Slices of the mapping are still alive somewhere. The
+                # mapping is closed when they are garbage collected.
+                pass
+        super().close()
+
+
+class _ReadaheadFile(io.RawIOBase):
+    """A read-only binary file object that keeps chunks of the underlying
+    file prefetched on a background thread, so file I/O overlaps with the
+    decompression done by the consumer."""
+
+    def __init__(self, fp, chunk_size=READ_BUFFER_SIZE, queue_size=4,
+                 closefd=False):
+        self.fp = fp
+        self.closefd = closefd
+        self._chunk_size = chunk_size
+        self._queue_size = queue_size
+        self._current = b""
+        self._current_pos = 0
+        self._at_eof = False
+        self._start_thread()
+
+    def _start_thread(self):
+        self._queue = queue.Queue(self._queue_size)
+        self._stop = threading.Event()
+        self._thread = threading.Thread(target=self._fill, daemon=True)
+        self._thread.start()
+
+    def _fill(self):
+        # Runs in the background thread. The underlying file is only
+        # touched here while the thread runs; seek() stops the thread
+        # before repositioning.
+        try:
+            while True:
+                chunk = self.fp.read(self._chunk_size)
+                while True:
+                    if self._stop.is_set():
+                        return
+                    try:
+                        self._queue.put(chunk, timeout=0.05)
+                        break
+                    except queue.Full:
+                        continue
+                if not chunk:  # b"" marks EOF for the consumer.
+                    return
+        except Exception as error:
+            while not self._stop.is_set():
+                try:
+                    self._queue.put(error, timeout=0.05)
+                    return
+                except queue.Full:
+                    continue
+
+    def _stop_thread(self):
+        self._stop.set()
+        # Unblock a producer waiting on a full queue.
+        while self._thread.is_alive():
+            try:
+                self._queue.get_nowait()
+            except queue.Empty:
+                pass
+            self._thread.join(timeout=0.01)
+
+    def readable(self) -> bool:
+        return True
+
+    def seekable(self) -> bool:
+        return self.fp.seekable()
+
+    def readinto(self, b) -> int:
+        with memoryview(b) as view:
+            if self._current_pos == len(self._current):
+                if self._at_eof:
+                    return 0
+                item = self._queue.get()
+                if isinstance(item, Exception):
+                    self._at_eof = True
+                    raise item
+                if not item:
+                    self._at_eof = True
+                    return 0
+                self._current = item
+                self._current_pos = 0
+            length = min(view.nbytes,
+                         len(self._current) - self._current_pos)
+            view[:length] = \
+                self._current[self._current_pos:self._current_pos + length]
+            self._current_pos += length
+            return length
+
+    def seek(self, offset, whence=io.SEEK_SET):
+        self._stop_thread()
+        position = self.fp.seek(offset, whence)
+        self._current = b""
+        self._current_pos = 0
+        self._at_eof = False
+        self._start_thread()
+        return position
+
+    def close(self):
+        if self.closed:
+            return
+        self._stop_thread()
+        if self.closefd:
+            self.fp.close()
+        super().close()
+
+
 class IGzipFile(gzip.GzipFile):
     """The IGzipFile class simulates most of the methods of a file object with
     the exception of the truncate() method.
@@ -204,6 +425,66 @@ class IGzipFile(gzip.GzipFile):
             self.offset += length
         return length
 
+    def readinto(self, b):
+        self._check_not_closed()
+        if self.mode != gzip.READ:
+            import errno
+            raise OSError(errno.EBADF,
+                          "readinto() on write-only IGzipFile object")
+        # BufferedReader serves large requests directly from the raw
+        # reader, whose readinto decompresses into the caller's buffer.
+        return self._buffer.readinto(b)
+
+    def readinto1(self, b):
+        self._check_not_closed()
+        if self.mode != gzip.READ:
+            import errno
+            raise OSError(errno.EBADF,
+                          "readinto1() on write-only IGzipFile object")
+        return self._buffer.readinto1(b)
+
+    def iter_lines(self, chunk_size=32 * 1024):
+        """Iterate over the lines of the decompressed data without
+        per-line buffer slicing in Python.
+
+        Lines are split on b"\\n" which is not included in the yielded
+        lines. The last line is yielded even if it does not end in a
+        newline. This is much faster than iterating over the file object
+        itself because the line scanning happens per *chunk_size* block of
+        decompressed data instead of per line.
+        """
+        self._check_not_closed()
+        if self.mode != gzip.READ:
+            import errno
+            raise OSError(errno.EBADF,
+                          "iter_lines() on write-only IGzipFile object")
+        return self._iter_lines(chunk_size)
+
+    def _iter_lines(self, chunk_size):
+        # The partial line at the end of each chunk is kept as a list of
+        # parts, so a line that spans many chunks is joined once instead
+        # of being copied per chunk.
+        carry = []
+        while True:
+            chunk = self.read(chunk_size)
+            if not chunk:
+                break
+            # bytes.split is a memchr-backed scanner in C, so this does
+            # one pass over the chunk and creates only the line objects.
+            lines = chunk.split(b"\n")
+            if len(lines) == 1:
+                carry.append(lines[0])
+                continue
+            if carry:
+                carry.append(lines[0])
+                lines[0] = b"".join(carry)
+                carry.clear()
+            carry.append(lines.pop())
+            yield from lines
+        last_line = b"".join(carry)
+        if last_line:
+            yield last_line
+
 
 class _PaddedFile(gzip._PaddedFile):
     # Overwrite _PaddedFile from gzip as its prepend method assumes that
@@ -211,7 +492,30 @@ class _PaddedFile(gzip._PaddedFile):
     # isal_zlib.decompressobj there is a bitbuffer as well which may be added.
     # So an extra check is added to prepend to ensure no extra data in front
     # of the buffer was present. (Negative self._read).
+    def read(self, size):
+        # Same as gzip._PaddedFile.read, except that data read from the
+        # file is converted to bytes before concatenating it with the
+        # prepended buffer, because memory-mapped files return memoryview
+        # slices.
+        if self._read is None:
+            return self.file.read(size)
+        if self._read + size <= self._length:
+            read = self._read
+            self._read += size
+            return self._buffer[read:self._read]
+        else:
+            read = self._read
+            self._read = None
+            return self._buffer[read:] + \
+                   bytes(self.file.read(size-self._length+read))
+
     def prepend(self, prepend=b''):
+        # The prepended data may be a memoryview slice (the one-byte
+        # peeks done on memory-mapped files); coerce it so that the
+        # buffer concatenation in read() always operates on bytes.
+        # bytes() of a bytes object returns the same object, so the
+        # common path does not copy.
+        prepend = bytes(prepend)
         if self._read is not None:
             # Assume data was read since the last prepend() call
             self._read -= len(prepend)
@@ -229,17 +533,124 @@ class _IGzipReader(gzip._GzipReader):
         # Call the init method of gzip._GzipReader's parent here.
         # It is not very invasive and allows us to override _PaddedFile
         _compression.DecompressReader.__init__(
-            self, _PaddedFile(fp), isal_zlib.decompressobj,
-            wbits=-isal_zlib.MAX_WBITS)
+            self, _PaddedFile(fp), igzip_lib.IgzipDecompressor,
+            flag=igzip_lib.DECOMP_GZIP_NO_HDR_VER)
         # Set flag indicating start of a new member
         self._new_member = True
         self._last_mtime = None
 
-    def _add_read_data(self, data):
-        # Use faster isal crc32 calculation and update the stream size in place
-        # compared to CPython gzip
-        self._crc = isal_zlib.crc32(data, self._crc)
-        self._stream_size += len(data)
+    def read(self, size=-1):
+        # This read method is based on gzip._GzipReader.read. The
+        # IgzipDecompressor retains unconsumed input internally and
+        # verifies the crc32 and length of each member against the gzip
+        # trailer, so all the per-chunk bookkeeping is done in C.
+        if size < 0:
+            return self.readall()
+        # size=0 is special because decompress(max_length=0) is not supported
+        if not size:
+            return b""
+
+        # For certain input data, a single
+        # call to decompress() may not return
+        # any data. In this case, retry until we get some data or reach EOF.
+        while True:
+            if self._decompressor.eof:
+                # Ending case: we've come to the end of a member in the
+                # file. The checksum and length in the trailer were already
+                # verified during decompression, so only the leftover data
+                # needs to be returned to the fileobj before a new gzip
+                # header can be read.
+                self._fp.prepend(self._decompressor.unused_data)
+                # Gzip files can be padded with zeroes and still have
+                # archives. Consume all zero bytes and set the file
+                # position to the first non-zero byte.
+                # See http://www.gzip.org/#faq8
+                c = b"\x00"
+                while c == b"\x00":
+                    c = self._fp.read(1)
+                if c:
+                    self._fp.prepend(c)
+                self._new_member = True
+                self._decompressor = self._decomp_factory(
+                    **self._decomp_args)
+
+            if self._new_member:
+                # If the _new_member flag is set, we have to
+                # jump to the next member, if there is one.
+                self._init_read()
+                if not self._read_gzip_header():
+                    self._size = self._pos
+                    return b""
+                self._new_member = False
+
+            # Read a chunk of data from the file
+            if self._decompressor.needs_input:
+                buf = self._fp.read(READ_BUFFER_SIZE)
+            else:
+                buf = b""
+
+            try:
+                uncompress = self._decompressor.decompress(buf, size)
+            except igzip_lib.IsalError as error:
+                raise BadGzipFile(str(error)) from error
+
+            if uncompress != b"":
+                break
+            if buf == b"" and not self._decompressor.eof:
+                raise EOFError("Compressed file ended before the "
+                               "end-of-stream marker was reached")
+
+        self._pos += len(uncompress)
+        return uncompress
+
+    def readinto(self, b):
+        # Decompress directly into the caller's buffer. Together with the
+        # direct-read path of io.BufferedReader this makes large reads
+        # into preallocated memory single-copy. Same structure as read().
+        with memoryview(b) as view:
+            if view.nbytes == 0:
+                return 0
+
+            while True:
+                if self._decompressor.eof:
+                    # See read() for an explanation of the member
+                    # handling. The trailer was verified during
+                    # decompression.
+                    self._fp.prepend(self._decompressor.unused_data)
+                    c = b"\x00"
+                    while c == b"\x00":
+                        c = self._fp.read(1)
+                    if c:
+                        self._fp.prepend(c)
+                    self._new_member = True
+                    self._decompressor = self._decomp_factory(
+                        **self._decomp_args)
+
+                if self._new_member:
+                    self._init_read()
+                    if not self._read_gzip_header():
+                        self._size = self._pos
+                        return 0
+                    self._new_member = False
+
+                if self._decompressor.needs_input:
+                    buf = self._fp.read(READ_BUFFER_SIZE)
+                else:
+                    buf = b""
+
+                try:
+                    written = self._decompressor.decompress_into(buf, view)
+                except igzip_lib.IsalError as error:
+                    raise BadGzipFile(str(error)) from error
+
+                if written > 0:
+                    break
+                if buf == b"" and not self._decompressor.eof:
+                    raise EOFError("Compressed file ended before the "
+                                   "end-of-stream marker was reached")
+
+            self._pos += written
+            return written
 
 
 # Aliases for improved compatibility with CPython gzip module.
@@ -326,24 +737,49 @@ def decompress(data):
     Return the decompressed string.
     """
     all_blocks: List[bytes] = []
+    first_member = True
     while True:
         if data == b"":
             break
         header_end = _gzip_header_end(data)
-        do = isal_zlib.decompressobj(-15)
-        block = do.decompress(data[header_end:]) + do.flush()
-        if not do.eof or len(do.unused_data) < 8:
+        if first_member:
+            # The last 4 bytes of a gzip stream hold the length of the
+            # *last* member (ISIZE, modulo 2**32). For the common
+            # single-member case this is the exact output size, so it is
+            # used to preallocate the output buffer and all growth
+            # reallocations are eliminated. The hint is capped at the
+            # maximum deflate ratio (1032:1) so a corrupt ISIZE field can
+            # not cause a huge allocation. Subsequent members of a
+            # multi-member stream get no hint: the trailer at the end
+            # belongs to a different member, and for many small members a
+            # final-member-sized allocation each would be pure waste.
+            isize = int.from_bytes(data[-4:], "little", signed=False)
+            max_plausible_size = (len(data) - header_end) * 1032 + 64
+            size_hint = isize if isize <= max_plausible_size else 0
+            first_member = False
+        else:
+            size_hint = 0
+        # DECOMP_GZIP_NO_HDR tracks the crc32 of the output in the
+        # decompression state, so no separate checksum pass over the
+        # output is needed.
+        do = igzip_lib.IgzipDecompressor(flag=igzip_lib.DECOMP_GZIP_NO_HDR)
+        try:
+            block = do.decompress(memoryview(data)[header_end:],
+                                  size_hint=size_hint)
+        except igzip_lib.IsalError as error:
+            raise BadGzipFile(str(error)) from error
+        unused_data = do.unused_data
+        if not do.eof or len(unused_data) < 8:
             raise EOFError("Compressed file ended before the end-of-stream "
                            "marker was reached")
-        checksum, length = struct.unpack("<II", do.unused_data[:8])
-        crc = isal_zlib.crc32(block)
-        if crc != checksum:
+        checksum, length = struct.unpack("<II", unused_data[:8])
+        if do.crc != checksum:
             raise BadGzipFile("CRC check failed")
         if length != len(block):
             raise BadGzipFile("Incorrect length of data produced")
         all_blocks.append(block)
         # Remove all padding null bytes and start next block.
-        data = do.unused_data[8:].lstrip(b"\x00")
+        data = unused_data[8:].lstrip(b"\x00")
     return b"".join(all_blocks)
 
 
@@ -378,6 +814,12 @@ def _argument_parser():
         help="Decompress the file instead of compressing.")
     parser.add_argument("-c", "--stdout", action="store_true",
                         help="write on standard output")
+    parser.add_argument("-T", "--threads", type=int, default=1,
+                        help="Use the given number of threads for "
+                             "block-parallel compression and "
+                             "decompression, with reading, "
+                             "(de)compression and writing pipelined on "
+                             "separate threads.")
     # -b flag not taken by either gzip or igzip. Hidden attribute. Above 32K
     # diminishing returns hit. _compression.BUFFER_SIZE = 8k. But 32K is about
     # ~6% faster.
@@ -388,9 +830,15 @@ def _argument_parser():
 
 
 def main():
+    # Imported here because igzip_threaded imports this module at startup.
+    from . import igzip_threaded
+
     args = _argument_parser().parse_args()
 
     compresslevel = args.compresslevel or _COMPRESS_LEVEL_TRADEOFF
+    if args.threads < 1:
+        sys.exit("threads should be at least 1")
+    threaded = args.threads > 1
 
     # Determine input file
     if args.compress and args.file is None:
@@ -398,21 +846,39 @@ def main():
     elif args.compress and args.file is not None:
         in_file = io.open(args.file, mode="rb")
     elif not args.compress and args.file is None:
-        in_file = IGzipFile(mode="rb", fileobj=sys.stdin.buffer)
+        if threaded:
+            in_file = igzip_threaded.open(sys.stdin.buffer, "rb",
+                                          threads=args.threads)
+        else:
+            in_file = IGzipFile(mode="rb", fileobj=sys.stdin.buffer)
     elif not args.compress and args.file is not None:
         base, extension = os.path.splitext(args.file)
         if extension != ".gz" and not args.stdout:
             sys.exit(f"filename doesn't end in .gz: {args.file!r}. "
                      f"Cannot determine output filename.")
-        in_file = open(args.file, "rb")
+        if threaded:
+            in_file = igzip_threaded.open(args.file, "rb",
+                                          threads=args.threads)
+        else:
+            in_file = open(args.file, "rb")
 
     # Determine output file
     if args.compress and (args.file is None or args.stdout):
-        out_file = IGzipFile(mode="wb", compresslevel=compresslevel,
-                             fileobj=sys.stdout.buffer)
+        if threaded:
+            out_file = igzip_threaded.open(sys.stdout.buffer, "wb",
+                                           compresslevel,
+                                           threads=args.threads)
+        else:
+            out_file = IGzipFile(mode="wb", compresslevel=compresslevel,
+                                 fileobj=sys.stdout.buffer)
     elif args.compress and args.file is not None:
-        out_file = open(args.file + ".gz", mode="wb",
-                        compresslevel=compresslevel)
+        if threaded:
+            out_file = igzip_threaded.open(args.file + ".gz", mode="wb",
+                                           compresslevel=compresslevel,
+                                           threads=args.threads)
+        else:
+            out_file = open(args.file + ".gz", mode="wb",
+                            compresslevel=compresslevel)
     elif not args.compress and (args.file is None or args.stdout):
         out_file = sys.stdout.buffer
     elif not args.compress and args.file is not None:
@@ -0,0 +1,200 @@
+# Copyright (c) 2020 Leiden University Medical Center
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Asynchronous reading of gzip files. A dedicated thread runs the igzip
+reader ahead of the consumer and hands decompressed chunks to the event
+loop through a bounded queue, so decompression overlaps with event-loop
+work instead of blocking it."""
+
+import asyncio
+import threading
+
+from . import igzip
+
+__all__ = ["AsyncIGzipFile", "open"]
+
+DEFAULT_CHUNK_SIZE = 128 * 1024
+
+# Sentinel placed on the queue when the reader thread is done.
+_EOF = object()
+
+
+def open(filename, mode="rb", chunk_size=DEFAULT_CHUNK_SIZE, queue_size=4):
+    """Open a gzip file for asynchronous reading.
+
+    :param filename: A filename or a binary file object.
+    :param mode: Only the read modes "r" and "rb" are supported.
+    :param chunk_size: The amount of decompressed bytes read per chunk by
+                       the background thread.
+    :param queue_size: The maximum number of chunks the background thread
+                       reads ahead of the consumer.
+    :return: An AsyncIGzipFile.
+    """
+    if mode not in ("r", "rb"):
+        raise ValueError("Only read modes are supported, not: "
+                         "{!r}".format(mode))
+    return AsyncIGzipFile(filename, chunk_size, queue_size)
+
+
+class AsyncIGzipFile:
+    """An asynchronous gzip reader.
+
+    Decompression runs on a background thread which stays *queue_size*
+    chunks ahead of the consumer. Supports ``await read(size)``,
+    ``await readline()``, asynchronous iteration over lines, and use as
+    an asynchronous context manager.
+    """
+
+    def __init__(self, filename, chunk_size=DEFAULT_CHUNK_SIZE,
+                 queue_size=4):
+        if chunk_size < 1:
+            raise ValueError("chunk_size should be at least 1")
+        if queue_size < 1:
+            raise ValueError("queue_size should be at least 1")
+        self._filename = filename
+        self._chunk_size = chunk_size
+        self._queue_size = queue_size
+        self._queue = None
+        self._loop = None
+        self._thread = None
+        self._abort = threading.Event()
+        self._buffer = bytearray()
+        self._at_eof = False
+        self._closed = False
+
+    def _ensure_started(self):
+        if self._thread is not None:
+            return
+        self._loop = asyncio.get_event_loop()
+        self._queue = asyncio.Queue(self._queue_size)
+        # A daemon thread so that an event loop that exits without
+        # aclose() being awaited can not hang interpreter shutdown on a
+        # producer that is blocked handing off a chunk.
+        self._thread = threading.Thread(target=self._fill_queue, daemon=True)
+        self._thread.start()
+
+    def _put(self, item):
+        # Runs in the reader thread. Blocks when the queue is full, which
+        # gives the bounded readahead.
+        future = asyncio.run_coroutine_threadsafe(self._queue.put(item),
+                                                  self._loop)
+        future.result()
+
+    def _fill_queue(self):
+        try:
+            with igzip.open(self._filename, "rb") as fileobj:
+                while not self._abort.is_set():
+                    chunk = fileobj.read(self._chunk_size)
+                    if not chunk:
+                        break
+                    self._put(chunk)
+        except Exception as error:
+            self._put(error)
+            return
+        self._put(_EOF)
+
+    async def _next_chunk(self):
+        """Await the next decompressed chunk, b"" at EOF."""
+        if self._at_eof:
+            return b""
+        self._ensure_started()
+        item = await self._queue.get()
+        if item is _EOF:
+            self._at_eof = True
+            return b""
+        if isinstance(item, Exception):
+            self._at_eof = True
+            raise item
+        return item
+
+    def _check_closed(self):
+        if self._closed:
+            raise ValueError("I/O operation on closed AsyncIGzipFile")
+
+    async def read(self, size=-1):
+        """Read and return up to *size* decompressed bytes. Reads until
+        EOF when size is negative."""
+        self._check_closed()
+        if size < 0:
+            parts = [bytes(self._buffer)]
+            self._buffer.clear()
+            while True:
+                chunk = await self._next_chunk()
+                if not chunk:
+                    break
+                parts.append(chunk)
+            return b"".join(parts)
+        while len(self._buffer) < size:
+            chunk = await self._next_chunk()
+            if not chunk:
+                break
+            self._buffer.extend(chunk)
+        result = bytes(self._buffer[:size])
+        del self._buffer[:size]
+        return result
+
+    async def readline(self):
+        """Read and return one line of decompressed data, including the
+        trailing newline. Returns b"" at EOF."""
+        self._check_closed()
+        while True:
+            newline_pos = self._buffer.find(b"\n")
+            if newline_pos != -1:
+                line = bytes(self._buffer[:newline_pos + 1])
+                del self._buffer[:newline_pos + 1]
+                return line
+            chunk = await self._next_chunk()
+            if not chunk:
+                line = bytes(self._buffer)
+                self._buffer.clear()
+                return line
+            self._buffer.extend(chunk)
+
+    def __aiter__(self):
+        return self
+
+    async def __anext__(self):
+        line = await self.readline()
+        if not line:
+            raise StopAsyncIteration
+        return line
+
+    async def aclose(self):
+        if self._closed:
+            return
+        self._closed = True
+        if self._thread is not None:
+            self._abort.set()
+            # Drain the queue so a reader thread blocked on a full queue
+            # can reach its sentinel.
+            while not self._at_eof:
+                item = await self._queue.get()
+                if item is _EOF or isinstance(item, Exception):
+                    self._at_eof = True
+            # The thread is past its last put here, so this join is
+            # near-instant and does not stall the event loop.
+            self._thread.join()
+        self._buffer.clear()
+
+    async def __aenter__(self):
+        return self
+
+    async def __aexit__(self, exc_type, exc_val, exc_tb):
+        await self.aclose()
@@ -0,0 +1,229 @@
+# Copyright (c) 2020 Leiden University Medical Center
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Checkpoint indexes for fast seeking in gzip files.
+
+A GzipIndex records pairs of (compressed offset, uncompressed offset) at
+gzip member boundaries. These are the positions in a gzip file where
+decompression can be restarted without any decompressor state, so a
+seek() can resume from the nearest checkpoint instead of re-decompressing
+from the start of the file. The index can be saved to and loaded from a
+small sidecar file.
+
+Multi-member files (such as those produced by bgzip or sharded log
+writers) get checkpoints roughly every *span* uncompressed bytes. A
+single-member file has only the (0, 0) checkpoint, in which case seeking
+degrades to the normal rewind-and-read behavior.
+"""
+
+import bisect
+import io
+import struct
+
+from . import igzip, igzip_lib
+
+__all__ = ["GzipIndex", "open"]
+
+_MAGIC = b"IGZIDX01"
+_READ_SIZE = 128 * 1024
+
+#: Record a checkpoint about every megabyte of uncompressed data.
+DEFAULT_SPAN = 1024 * 1024
+
+
+class GzipIndex:
+    """An index of positions where decompression of a gzip file can be
+    resumed, with their corresponding uncompressed offsets."""
+
+    def __init__(self, checkpoints, uncompressed_size, compressed_size):
+        self.checkpoints = checkpoints
+        self.uncompressed_size = uncompressed_size
+        self.compressed_size = compressed_size
+
+    @classmethod
+    def build(cls, fileobj, span=DEFAULT_SPAN):
+        """Build an index by decompressing the entire *fileobj* once,
+        recording a checkpoint at the first member boundary after every
+        *span* uncompressed bytes."""
+        checkpoints = [(0, 0)]
+        total_read = 0  # Compressed bytes read from fileobj.
+        uncompressed_pos = 0
+        leftover = b""
+        file_ended = False
+        while True:
+            # Skip zero padding between members.
+            while True:
+                leftover = leftover.lstrip(b"\x00")
+                if leftover:
+                    break
+                leftover = fileobj.read(_READ_SIZE)
+                if not leftover:
+                    file_ended = True
+                    break
+                total_read += len(leftover)
+            if file_ended:
+                break
+            member_offset = total_read - len(leftover)
+            if (member_offset != 0 and
+                    uncompressed_pos - checkpoints[-1][1] >= span):
+                checkpoints.append((member_offset, uncompressed_pos))
+            decompressor = igzip_lib.IgzipDecompressor(
+                flag=igzip_lib.DECOMP_GZIP)
+            while not decompressor.eof:
+                if decompressor.needs_input:
+                    if leftover:
+                        data = leftover
+                        leftover = b""
+                    else:
+                        data = fileobj.read(_READ_SIZE)
+                        if not data:
+                            raise EOFError(
+                                "Compressed file ended before the "
+                                "end-of-stream marker was reached")
+                        total_read += len(data)
+                else:
+                    data = b""
+                uncompressed_pos += len(decompressor.decompress(data))
+            leftover = decompressor.unused_data
+        return cls(checkpoints, uncompressed_pos, total_read)
+
+    @classmethod
+    def from_file(cls, filename, span=DEFAULT_SPAN):
+        """Build an index for the gzip file at *filename*."""
+        with io.open(filename, "rb") as fileobj:
+            return cls.build(fileobj, span)
+
+    def best_checkpoint(self, offset):
+        """Return the (compressed_offset, uncompressed_offset) checkpoint
+        closest before *offset*."""
+        uncompressed_offsets = [point[1] for point in self.checkpoints]
+        index = bisect.bisect_right(uncompressed_offsets, offset) - 1
+        if index < 0:
+            index = 0
+        return self.checkpoints[index]
+
+    def save(self, filename):
+        """Save the index to a sidecar file."""
+        with io.open(filename, "wb") as fileobj:
+            fileobj.write(_MAGIC)
+            fileobj.write(struct.pack("<QQQ", len(self.checkpoints),
+                                      self.compressed_size,
+                                      self.uncompressed_size))
+            for compressed_offset, uncompressed_offset in self.checkpoints:
+                fileobj.write(struct.pack("<QQ", compressed_offset,
+                                          uncompressed_offset))
+
+    @classmethod
+    def load(cls, filename):
+        """Load an index from a sidecar file written by save()."""
+        with io.open(filename, "rb") as fileobj:
+            magic = fileobj.read(len(_MAGIC))
+            if magic != _MAGIC:
+                raise ValueError(
+                    "Not a gzip index file: {!r}".format(filename))
+            count, compressed_size, uncompressed_size = struct.unpack(
+                "<QQQ", fileobj.read(24))
+            checkpoints = []
+            for _ in range(count):
+                checkpoints.append(struct.unpack("<QQ", fileobj.read(16)))
+        return cls(checkpoints, uncompressed_size, compressed_size)
+
+
+class _IndexedIGzipReader(igzip._IGzipReader):
+    """An _IGzipReader that uses a GzipIndex to seek in O(span) instead of
+    re-decompressing from the start of the file."""
+
+    def __init__(self, fp, index: GzipIndex, closefd: bool = False):
+        super().__init__(fp)
+        self._index = index
+        self._closefd = closefd
+
+    def close(self):
+        if self.closed:
+            return
+        super().close()
+        if self._closefd:
+            self._fp.file.close()
+
+    def _jump_to_checkpoint(self, checkpoint):
+        compressed_offset, uncompressed_offset = checkpoint
+        self._fp.seek(compressed_offset)
+        self._eof = False
+        self._pos = uncompressed_offset
+        self._decompressor = self._decomp_factory(**self._decomp_args)
+        self._new_member = True
+
+    def seek(self, offset, whence=io.SEEK_SET):
+        if whence == io.SEEK_SET:
+            pass
+        elif whence == io.SEEK_CUR:
+            offset = self._pos + offset
+        elif whence == io.SEEK_END:
+            # The total size is recorded in the index, so seeking from the
+            # end does not require decompressing the whole file first.
+            offset = self._index.uncompressed_size + offset
+        else:
+            raise ValueError("Invalid value for whence: {}".format(whence))
+        if offset < 0:
+            raise ValueError("Negative seek position {}".format(offset))
+
+        checkpoint = self._index.best_checkpoint(offset)
+        if offset < self._pos or checkpoint[1] > self._pos:
+            # Jumping is only faster when the checkpoint lies beyond the
+            # current position; otherwise read ahead from where we are.
+            self._jump_to_checkpoint(checkpoint)
+
+        # Read and discard data until we reach the desired position.
+        while self._pos < offset:
+            data = self.read(min(io.DEFAULT_BUFFER_SIZE,
+                                 offset - self._pos))
+            if not data:
+                break
+        return self._pos
+
+
+def open(filename, mode="rb", index=None, span=DEFAULT_SPAN):
+    """Open a gzip file for reading with checkpoint-based seeking.
+
+    :param filename: A filename or a file object opened for binary
+                     reading. File objects must be seekable.
+    :param mode: Only the read modes "r" and "rb" are supported.
+    :param index: A GzipIndex for this file, for example loaded from a
+                  sidecar file. When None, an index is built first by
+                  decompressing the file once.
+    :param span: The checkpoint interval used when building an index.
+    :return: A BufferedReader delivering the decompressed stream.
+    """
+    if mode not in ("r", "rb"):
+        raise ValueError("Only read modes are supported, not: "
+                         "{!r}".format(mode))
+    if isinstance(filename, (str, bytes)) or hasattr(filename, "__fspath__"):
+        binary_file = io.open(filename, "rb")
+        closefd = True
+    elif hasattr(filename, "read"):
+        binary_file = filename
+        closefd = False
+    else:
+        raise TypeError("filename must be a str or bytes object, or a file")
+    if index is None:
+        index = GzipIndex.build(binary_file, span)
+        binary_file.seek(0)
+    raw = _IndexedIGzipReader(binary_file, index, closefd=closefd)
+    return io.BufferedReader(raw)
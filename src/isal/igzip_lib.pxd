@@ -189,6 +189,25 @@ cdef extern from "<isa-l/igzip_lib.h>":
     cdef struct isal_hufftables:
         pass
 
+    # Histogram of deflate symbols used to train custom Huffman tables.
+    # Only used through a pointer, the members are defined in igzip_lib.h.
+    cdef struct isal_huff_histogram:
+        pass
+
+    # /**
+    #  * @brief Updates the histogram of deflate symbols that would be
+    #  * produced for in_stream. Multiple calls accumulate.
+    #  */
+    cdef void isal_update_histogram(unsigned char *in_stream, int length,
+                                    isal_huff_histogram *histogram) nogil
+
+    # /**
+    #  * @brief Creates Huffman tables from a histogram, for use in the
+    #  * hufftables member of an isal_zstream.
+    #  */
+    cdef int isal_create_hufftables(isal_hufftables *hufftables,
+                                    isal_huff_histogram *histogram)
+
     cdef struct isal_zstream:
         unsigned char *next_in  #!< Next input byte
         unsigned int avail_in  #!< number of bytes available at next_in
@@ -264,6 +283,31 @@ cdef extern from "<isa-l/igzip_lib.h>":
                                    unsigned char *dict,
                                    unsigned int dict_len )
 
+    # Structure holding a preprocessed dictionary. Only used through a
+    # pointer, the members are defined in igzip_lib.h.
+    cdef struct isal_dict:
+        pass
+
+    # /**
+    #  * @brief Processes a dictionary so it can be applied to streams
+    #  * repeatedly with isal_deflate_reset_dict. The stream determines the
+    #  * level and hash size the dictionary is processed for; these must
+    #  * match the streams the dictionary is later applied to.
+    #  */
+    cdef int isal_deflate_process_dict(isal_zstream *stream,
+                                       isal_dict *dict_str,
+                                       unsigned char *dict,
+                                       unsigned int dict_len)
+
+    # /**
+    #  * @brief Set a processed dictionary on an initialized stream. A
+    #  * cheap copy compared to the hashing done by isal_deflate_set_dict.
+    #  * Returns ISAL_INVALID_STATE when the stream's level or hash sizes
+    #  * do not match those the dictionary was processed with.
+    #  */
+    cdef int isal_deflate_reset_dict(isal_zstream *stream,
+                                     isal_dict *dict_str)
+
 
     #/**
     #  * @brief Fast data (deflate) compression for storage applications.
@@ -319,7 +363,7 @@ cdef extern from "<isa-l/igzip_lib.h>":
     #  *         ISAL_INVALID_LEVEL (if an invalid compression level is selected),
     #  *         ISAL_INVALID_LEVEL_BUF (if the level buffer is not large enough).
     #  */
-    cdef int isal_deflate(isal_zstream *stream)
+    cdef int isal_deflate(isal_zstream *stream) nogil
 
     #/**
     #  * @brief Fast data (deflate) stateless compression for storage applications.
@@ -348,7 +392,7 @@ cdef extern from "<isa-l/igzip_lib.h>":
     #  *         ISAL_INVALID_LEVEL_BUF (if the level buffer is not large enough),
     #  *         STATELESS_OVERFLOW (if output buffer will not fit output).
     #  */
-    cdef int isal_deflate_stateless(isal_zstream *stream)
+    cdef int isal_deflate_stateless(isal_zstream *stream) nogil
 
 
     ###########################
@@ -430,7 +474,7 @@ cdef extern from "<isa-l/igzip_lib.h>":
     #  *         ISAL_UNSUPPORTED_METHOD,
     #  *         ISAL_INCORRECT_CHECKSUM.
     #  */
-    int isal_inflate(inflate_state *state)
+    int isal_inflate(inflate_state *state) nogil
 
     ##########################
     # Other functions
@@ -449,7 +493,7 @@ cdef extern from "<isa-l/igzip_lib.h>":
     #  */
     unsigned int isal_adler32(unsigned int init,
                                const unsigned char *buf, 
-                               unsigned long long len)
+                               unsigned long long len) nogil
 
 ############################
 # python-isal functions
@@ -490,11 +534,20 @@ cdef:
 
 cdef int mem_level_to_bufsize(int compression_level, int mem_level, unsigned int *bufsize)
 
+cdef class PreparedDict:
+    cdef isal_dict *processed
+    cdef readonly int level
+    cdef readonly bytes dictionary
+
+cdef class HuffmanTables:
+    cdef isal_hufftables *hufftables
+
 cpdef compress(data,
              int level= ?,
              int flag = ?,
              int mem_level = ?,
              int hist_bits = ?,
+             hufftables = ?,
             )
 
 cpdef decompress(data,
@@ -18,6 +18,8 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
+from typing import Iterable, List, Union
+
 ISAL_BEST_SPEED: int
 ISAL_BEST_COMPRESSION: int
 ISAL_DEFAULT_COMPRESSION: int
@@ -46,10 +48,68 @@ MEM_LEVEL_LARGE: int
 MEM_LEVEL_EXTRA_LARGE: int
 IsalError: OSError
 
+class HuffmanTables: ...
+
+def train_hufftables(sample_data) -> HuffmanTables: ...
+
+class PreparedDict:
+    level: int
+    dictionary: bytes
+
+    def __init__(self, dictionary,
+                 level: int = ISAL_DEFAULT_COMPRESSION) -> None: ...
+
+class IgzipDecompressor:
+    eof: bool
+    needs_input: bool
+    unused_data: bytes
+    crc: int
+
+    def __init__(self, flag: int = DECOMP_DEFLATE,
+                 hist_bits: int = MAX_HIST_BITS,
+                 zdict = None) -> None: ...
+    def decompress(self, data, max_length: int = -1,
+                   size_hint: int = 0) -> bytes: ...
+    def decompress_into(self, data, out) -> int: ...
+
 def compress(data, level: int = ISAL_DEFAULT_COMPRESSION,
              flag: int = COMP_DEFLATE,
              mem_level: int = MEM_LEVEL_DEFAULT,
-             hist_bits: int = MAX_HIST_BITS) -> bytes: ...
+             hist_bits: int = MAX_HIST_BITS,
+             hufftables: HuffmanTables = None) -> bytes: ...
 def decompress(data, flag: int = DECOMP_DEFLATE,
                hist_bits: int = MAX_HIST_BITS,
                bufsize: int = DEF_BUF_SIZE) -> bytes: ...
+def decompress_chunks(data, flag: int = DECOMP_DEFLATE,
+                      hist_bits: int = MAX_HIST_BITS,
+                      chunk_size: int = 512 * 1024) -> List[bytes]: ...
+def decompress_members(data, bufsize: int = DEF_BUF_SIZE) -> bytes: ...
+def compress_batch(items: Iterable, level: int = ISAL_DEFAULT_COMPRESSION,
+                   flag: int = COMP_DEFLATE,
+                   mem_level: int = MEM_LEVEL_DEFAULT,
+                   hist_bits: int = MAX_HIST_BITS) -> List[bytes]: ...
+def decompress_batch(items: Iterable, flag: int = DECOMP_DEFLATE,
+                     hist_bits: int = MAX_HIST_BITS) -> List[bytes]: ...
+def compress_file(src, dst, level: int = ISAL_DEFAULT_COMPRESSION,
+                  flag: int = COMP_GZIP,
+                  mem_level: int = MEM_LEVEL_DEFAULT,
+                  hist_bits: int = MAX_HIST_BITS,
+                  block_size: int = 512 * 1024) -> int: ...
+def decompress_file(src, dst, flag: int = DECOMP_GZIP,
+                    hist_bits: int = MAX_HIST_BITS,
+                    block_size: int = 512 * 1024) -> int: ...
+def compress_stateless(data, level: int = ISAL_DEFAULT_COMPRESSION,
+                       flag: int = COMP_DEFLATE,
+                       mem_level: int = MEM_LEVEL_DEFAULT,
+                       hist_bits: int = MAX_HIST_BITS,
+                       out = None) -> Union[bytes, int]: ...
+def decompress_stateless(data, flag: int = DECOMP_DEFLATE,
+                         hist_bits: int = MAX_HIST_BITS,
+                         bufsize: int = DEF_BUF_SIZE,
+                         out = None) -> Union[bytes, int]: ...
+def compress_into(data, out, level: int = ISAL_DEFAULT_COMPRESSION,
+                  flag: int = COMP_DEFLATE,
+                  mem_level: int = MEM_LEVEL_DEFAULT,
+                  hist_bits: int = MAX_HIST_BITS) -> int: ...
+def decompress_into(data, out, flag: int = DECOMP_DEFLATE,
+                    hist_bits: int = MAX_HIST_BITS) -> int: ...
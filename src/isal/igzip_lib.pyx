@@ -41,18 +41,18 @@ This module comes with the following constants:
 ``DECOMP_DEFLATE``             Flag to decompress a raw deflate block.
 ``DECOMP_GZIP``                Flag to decompress a gzip block including header
                                and verify the checksums in the trailer.
-``DECOMP_GZIP_NO_HDR``         Flag to decompress a gzip block without a header
-                               and verify the checksums in the trailer.
+``DECOMP_GZIP_NO_HDR``         Flag to decompress a gzip block without a
+                               header, tracking the crc32 of the output in the
+                               decompression state without verifying it.
 ``DECOMP_GZIP_NO_HDR_VER``     Flag to decompress a gzip block without a header
-                               and without verifying the checksums in the
-                               trailer.
-``DECOMP_ZLIB``                Flag to decompress a zlib block including header
                                and verify the checksums in the trailer.
-``DECOMP_ZLIB_NO_HDR``         Flag to decompress a zlib block without a header
+``DECOMP_ZLIB``                Flag to decompress a zlib block including header
                                and verify the checksums in the trailer.
+``DECOMP_ZLIB_NO_HDR``         Flag to decompress a zlib block without a
+                               header, tracking the adler32 of the output in
+                               the decompression state without verifying it.
 ``DECOMP_ZLIB_NO_HDR_VER``     Flag to decompress a zlib block without a header
-                               and without verifying the checksums in the
-                               trailer.
+                               and verify the checksums in the trailer.
 ``MEM_LEVEL_DEFAULT``          The default memory level for the internal level
                                buffer. (Equivalent to
                                MEM_LEVEL_LARGE.)
@@ -64,10 +64,15 @@ This module comes with the following constants:
 ============================== ================================================
 """
 
+import io
+import threading
+
 from libc.stdint cimport UINT64_MAX, UINT32_MAX
+from libc.string cimport memcpy, memmove, memset
 from cpython.mem cimport PyMem_Malloc, PyMem_Realloc, PyMem_Free
-from cpython.buffer cimport PyBUF_C_CONTIGUOUS, PyObject_GetBuffer, PyBuffer_Release
-from cpython.bytes cimport PyBytes_FromStringAndSize
+from cpython.buffer cimport (PyBUF_C_CONTIGUOUS, PyBUF_WRITABLE,
+                             PyObject_GetBuffer, PyBuffer_Release)
+from cpython.bytes cimport PyBytes_FromStringAndSize, PyBytes_AS_STRING
 
 cdef extern from "<Python.h>":
     const Py_ssize_t PY_SSIZE_T_MAX
@@ -169,6 +174,7 @@ cpdef compress(data,
              int flag = IGZIP_DEFLATE,
              int mem_level = MEM_LEVEL_DEFAULT_I,
              int hist_bits = ISAL_DEF_MAX_HIST_BITS,
+             hufftables = None,
             ):
     """
     Compresses the bytes in *data*. Returns a bytes object with the
@@ -191,11 +197,23 @@ cpdef compress(data,
                       2^hist_bits. Similar to zlib wbits value, except that 
                       hist_bits is not used to set the compression flag.
                       This is best left at the default (15, maximum).
+    :param hufftables: Custom Huffman tables created by train_hufftables.
+                       Only used by level 0 compression.
     """
+    if hufftables is not None:
+        if not isinstance(hufftables, HuffmanTables):
+            raise TypeError("hufftables must be a HuffmanTables object, "
+                            "got: {0}".format(type(hufftables)))
+        if (<HuffmanTables>hufftables).hufftables is NULL:
+            raise ValueError("hufftables was not created by "
+                             "train_hufftables")
+    if not (ISAL_DEF_MIN_LEVEL <= level <= ISAL_DEF_MAX_LEVEL):
+        raise ValueError("Invalid compression level.")
     # Initialise stream
     cdef isal_zstream stream
     cdef unsigned int level_buf_size
-    mem_level_to_bufsize(level, MEM_LEVEL_DEFAULT_I, &level_buf_size)
+    if mem_level_to_bufsize(level, mem_level, &level_buf_size) != 0:
+        raise ValueError("Invalid memory level: {0}".format(mem_level))
     cdef unsigned char* level_buf = <unsigned char*> PyMem_Malloc(level_buf_size * sizeof(char))
     isal_deflate_init(&stream)
     stream.level = level
@@ -203,6 +221,8 @@ cpdef compress(data,
     stream.level_buf_size = level_buf_size
     stream.hist_bits = hist_bits
     stream.gzip_flag = flag
+    if hufftables is not None:
+        stream.hufftables = (<HuffmanTables>hufftables).hufftables
 
     # Initialise output buffer
     cdef Py_ssize_t bufsize = DEF_BUF_SIZE_I
@@ -232,7 +252,8 @@ cpdef compress(data,
                 bufsize = arrange_output_buffer(&stream, &obuf, bufsize)
                 if bufsize == -1:
                     raise MemoryError("Unsufficient memory for buffer allocation")
-                err = isal_deflate(&stream)
+                with nogil:
+                    err = isal_deflate(&stream)
                 if err != COMP_OK:
                     check_isal_deflate_rc(err)
                 if stream.avail_out != 0:
@@ -298,7 +319,8 @@ cpdef decompress(data,
                 bufsize = arrange_output_buffer(&stream, &obuf, bufsize)
                 if bufsize == -1:
                     raise MemoryError("Unsufficient memory for buffer allocation")
-                err = isal_inflate(&stream)
+                with nogil:
+                    err = isal_inflate(&stream)
                 if err != ISAL_DECOMP_OK:
                     check_isal_inflate_rc(err)
                 if stream.avail_out != 0:
@@ -313,6 +335,1348 @@ cpdef decompress(data,
         PyMem_Free(obuf)
 
 
+def compress_batch(items,
+                   int level=ISAL_DEFAULT_COMPRESSION_I,
+                   int flag = IGZIP_DEFLATE,
+                   int mem_level = MEM_LEVEL_DEFAULT_I,
+                   int hist_bits = ISAL_DEF_MAX_HIST_BITS):
+    """
+    Compresses a sequence of buffer-protocol objects independently in a
+    single call, returning a list of bytes objects. The level buffer and
+    the output scratch buffer are allocated once and reused for every
+    record, and the GIL is released during the ISA-L calls, so per-record
+    overhead is a stream init instead of a full Python call.
+
+    The other parameters are the same as for compress and apply to every
+    record.
+    """
+    if not (ISAL_DEF_MIN_LEVEL <= level <= ISAL_DEF_MAX_LEVEL):
+        raise ValueError("Invalid compression level.")
+    cdef isal_zstream stream
+    cdef unsigned int level_buf_size
+    if mem_level_to_bufsize(level, mem_level, &level_buf_size) != 0:
+        raise ValueError("Invalid memory level: {0}".format(mem_level))
+    cdef unsigned char* level_buf = <unsigned char*> PyMem_Malloc(level_buf_size * sizeof(char))
+
+    cdef unsigned char * obuf = NULL
+    cdef Py_ssize_t obuflen = DEF_BUF_SIZE_I
+    cdef list results = []
+
+    cdef Py_buffer buffer_data
+    cdef Py_buffer* buffer = &buffer_data
+    cdef Py_ssize_t ibuflen
+    cdef int err
+    try:
+        for item in items:
+            # Cython makes sure error is handled when acquiring buffer
+            # fails.
+            PyObject_GetBuffer(item, buffer, PyBUF_C_CONTIGUOUS)
+            try:
+                isal_deflate_init(&stream)
+                stream.level = level
+                stream.level_buf = level_buf
+                stream.level_buf_size = level_buf_size
+                stream.hist_bits = hist_bits
+                stream.gzip_flag = flag
+                stream.next_in = <unsigned char*>buffer.buf
+                ibuflen = buffer.len
+                if obuf is not NULL:
+                    # Reuse the scratch buffer of the previous record.
+                    stream.next_out = obuf
+                while True:
+                    arrange_input_buffer(&stream, &ibuflen)
+                    if ibuflen == 0:
+                        stream.flush = FULL_FLUSH
+                        stream.end_of_stream = 1
+                    else:
+                        stream.flush = NO_FLUSH
+                    while True:
+                        obuflen = arrange_output_buffer(&stream, &obuf, obuflen)
+                        if obuflen == -1:
+                            raise MemoryError("Unsufficient memory for buffer allocation")
+                        with nogil:
+                            err = isal_deflate(&stream)
+                        if err != COMP_OK:
+                            check_isal_deflate_rc(err)
+                        if stream.avail_out != 0:
+                            break
+                    if stream.internal_state.state == ZSTATE_END:
+                        break
+                results.append(PyBytes_FromStringAndSize(
+                    <char*>obuf, stream.next_out - obuf))
+            finally:
+                PyBuffer_Release(buffer)
+        return results
+    finally:
+        PyMem_Free(obuf)
+        PyMem_Free(level_buf)
+
+
+def decompress_batch(items,
+                     int flag = ISAL_DEFLATE,
+                     int hist_bits=ISAL_DEF_MAX_HIST_BITS):
+    """
+    Decompresses a sequence of independently compressed buffer-protocol
+    objects in a single call, returning a list of bytes objects. The
+    inflate state and the output scratch buffer are reused for every
+    record, so per-record overhead is a state reset instead of a full
+    Python call.
+
+    The *flag* and *hist_bits* parameters are the same as for decompress
+    and apply to every record.
+    """
+    cdef inflate_state stream
+    isal_inflate_init(&stream)
+
+    cdef unsigned char * obuf = NULL
+    cdef Py_ssize_t obuflen = DEF_BUF_SIZE_I
+    cdef list results = []
+    cdef bint first = True
+
+    cdef Py_buffer buffer_data
+    cdef Py_buffer* buffer = &buffer_data
+    cdef Py_ssize_t ibuflen
+    cdef int err
+    try:
+        for item in items:
+            # Cython makes sure error is handled when acquiring buffer
+            # fails.
+            PyObject_GetBuffer(item, buffer, PyBUF_C_CONTIGUOUS)
+            try:
+                if not first:
+                    isal_inflate_reset(&stream)
+                first = False
+                stream.hist_bits = hist_bits
+                stream.crc_flag = flag
+                stream.next_in = <unsigned char*>buffer.buf
+                ibuflen = buffer.len
+                if obuf is not NULL:
+                    # Reuse the scratch buffer of the previous record.
+                    stream.next_out = obuf
+                while True:
+                    arrange_input_buffer(&stream, &ibuflen)
+                    while True:
+                        obuflen = arrange_output_buffer(&stream, &obuf, obuflen)
+                        if obuflen == -1:
+                            raise MemoryError("Unsufficient memory for buffer allocation")
+                        with nogil:
+                            err = isal_inflate(&stream)
+                        if err != ISAL_DECOMP_OK:
+                            check_isal_inflate_rc(err)
+                        if stream.avail_out != 0:
+                            break
+                    if ibuflen == 0 or stream.block_state == ISAL_BLOCK_FINISH:
+                        break
+                if stream.block_state != ISAL_BLOCK_FINISH:
+                    raise IsalError("incomplete or truncated stream")
+                results.append(PyBytes_FromStringAndSize(
+                    <char*>obuf, stream.next_out - obuf))
+            finally:
+                PyBuffer_Release(buffer)
+        return results
+    finally:
+        PyMem_Free(obuf)
+
+
+def _write_all(dst_io, view):
+    # A raw FileIO.write may be partial when the destination is a pipe
+    # or socket; loop until the whole buffer is written.
+    cdef Py_ssize_t total = 0
+    cdef Py_ssize_t length = len(view)
+    while total < length:
+        written = dst_io.write(view[total:])
+        if written is None:
+            raise BlockingIOError(
+                "write to non-blocking file descriptor would block")
+        total += written
+
+
+def compress_file(src, dst,
+                  int level=ISAL_DEFAULT_COMPRESSION_I,
+                  int flag = IGZIP_GZIP,
+                  int mem_level = MEM_LEVEL_DEFAULT_I,
+                  int hist_bits = ISAL_DEF_MAX_HIST_BITS,
+                  Py_ssize_t block_size = 512 * 1024):
+    """
+    Compresses the file descriptor (or fileno()-supporting object) *src*
+    to the file descriptor *dst* with two reused buffers. The whole
+    read-compress-write loop runs without creating bytes objects per
+    block and the GIL is released during compression, so large files are
+    processed with minimal interpreter overhead. Returns the number of
+    compressed bytes written.
+
+    :param flag: Controls the header and trailer, COMP_GZIP by default so
+                 the output is a valid gzip file.
+    :param block_size: The amount of bytes read per iteration.
+    """
+    if not (0 < block_size <= UINT32_MAX):
+        raise ValueError("block_size must be between 1 and 2**32-1")
+    if not (ISAL_DEF_MIN_LEVEL <= level <= ISAL_DEF_MAX_LEVEL):
+        raise ValueError("Invalid compression level.")
+    cdef unsigned int level_buf_size
+    if mem_level_to_bufsize(level, mem_level, &level_buf_size) != 0:
+        raise ValueError("Invalid memory level: {0}".format(mem_level))
+    src_io = io.FileIO(src if isinstance(src, int) else src.fileno(),
+                       "rb", closefd=False)
+    dst_io = io.FileIO(dst if isinstance(dst, int) else dst.fileno(),
+                       "wb", closefd=False)
+    in_buf = bytearray(block_size)
+    # Room for the worst case expansion of one block plus headers.
+    cdef Py_ssize_t out_len = block_size + (block_size >> 9) + 100
+    out_buf = bytearray(out_len)
+    out_mem = memoryview(out_buf)
+
+    cdef Py_buffer in_view_data
+    cdef Py_buffer* in_view = &in_view_data
+    PyObject_GetBuffer(in_buf, in_view, PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE)
+    cdef Py_buffer out_view_data
+    cdef Py_buffer* out_view = &out_view_data
+    try:
+        PyObject_GetBuffer(out_buf, out_view,
+                           PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE)
+    except BaseException:
+        PyBuffer_Release(in_view)
+        raise
+
+    cdef isal_zstream stream
+    cdef unsigned char* level_buf = <unsigned char*> PyMem_Malloc(level_buf_size * sizeof(char))
+    isal_deflate_init(&stream)
+    stream.level = level
+    stream.level_buf = level_buf
+    stream.level_buf_size = level_buf_size
+    stream.hist_bits = hist_bits
+    stream.gzip_flag = flag
+
+    cdef Py_ssize_t total_out = 0
+    cdef Py_ssize_t n, produced
+    cdef int err
+    try:
+        while True:
+            n = src_io.readinto(in_buf)
+            stream.next_in = <unsigned char*>in_view.buf
+            stream.avail_in = <unsigned int>n
+            if n == 0:
+                stream.flush = FULL_FLUSH
+                stream.end_of_stream = 1
+            while True:
+                stream.next_out = <unsigned char*>out_view.buf
+                stream.avail_out = <unsigned int>out_len
+                with nogil:
+                    err = isal_deflate(&stream)
+                if err != COMP_OK:
+                    check_isal_deflate_rc(err)
+                produced = out_len - stream.avail_out
+                if produced > 0:
+                    _write_all(dst_io, out_mem[:produced])
+                    total_out += produced
+                if stream.avail_in == 0 and stream.avail_out != 0:
+                    break
+            if stream.internal_state.state == ZSTATE_END:
+                break
+        return total_out
+    finally:
+        PyBuffer_Release(in_view)
+        PyBuffer_Release(out_view)
+        PyMem_Free(level_buf)
+        src_io.close()
+        dst_io.close()
+
+
+def decompress_file(src, dst,
+                    int flag = ISAL_GZIP,
+                    int hist_bits = ISAL_DEF_MAX_HIST_BITS,
+                    Py_ssize_t block_size = 512 * 1024):
+    """
+    Decompresses the file descriptor (or fileno()-supporting object)
+    *src* to the file descriptor *dst* with two reused buffers and the
+    GIL released during decompression. With the default DECOMP_GZIP flag
+    concatenated multi-member files are handled, including zero padding
+    between members, and the trailer of each member is verified. Returns
+    the number of decompressed bytes written.
+
+    :param block_size: The amount of bytes read per iteration.
+    """
+    if not (0 < block_size <= UINT32_MAX):
+        raise ValueError("block_size must be between 1 and 2**32-1")
+    src_io = io.FileIO(src if isinstance(src, int) else src.fileno(),
+                       "rb", closefd=False)
+    dst_io = io.FileIO(dst if isinstance(dst, int) else dst.fileno(),
+                       "wb", closefd=False)
+    in_buf = bytearray(block_size)
+    out_buf = bytearray(block_size)
+    out_mem = memoryview(out_buf)
+
+    cdef Py_buffer in_view_data
+    cdef Py_buffer* in_view = &in_view_data
+    PyObject_GetBuffer(in_buf, in_view, PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE)
+    cdef Py_buffer out_view_data
+    cdef Py_buffer* out_view = &out_view_data
+    try:
+        PyObject_GetBuffer(out_buf, out_view,
+                           PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE)
+    except BaseException:
+        PyBuffer_Release(in_view)
+        raise
+
+    cdef inflate_state stream
+    isal_inflate_init(&stream)
+    stream.hist_bits = hist_bits
+    stream.crc_flag = flag
+    stream.avail_in = 0
+
+    cdef bint multi_member = flag == ISAL_GZIP
+    cdef bint at_member_boundary = False
+    cdef bint finished = False
+    cdef Py_ssize_t total_out = 0
+    cdef Py_ssize_t n, produced
+    cdef int err
+    try:
+        while not finished:
+            n = src_io.readinto(in_buf)
+            if n == 0:
+                if at_member_boundary:
+                    break  # Clean end of file after a complete member.
+                raise IsalError("incomplete or truncated stream")
+            stream.next_in = <unsigned char*>in_view.buf
+            stream.avail_in = <unsigned int>n
+            while True:
+                if at_member_boundary:
+                    # Skip zero padding between members.
+                    with nogil:
+                        while (stream.avail_in > 0 and
+                               stream.next_in[0] == 0):
+                            stream.next_in += 1
+                            stream.avail_in -= 1
+                    if stream.avail_in == 0:
+                        break
+                    if not multi_member:
+                        # Trailing data after the stream is ignored, like
+                        # in decompress.
+                        finished = True
+                        break
+                    isal_inflate_reset(&stream)
+                    stream.crc_flag = flag
+                    at_member_boundary = False
+                stream.next_out = <unsigned char*>out_view.buf
+                stream.avail_out = <unsigned int>block_size
+                with nogil:
+                    err = isal_inflate(&stream)
+                if err != ISAL_DECOMP_OK:
+                    check_isal_inflate_rc(err)
+                produced = block_size - stream.avail_out
+                if produced > 0:
+                    _write_all(dst_io, out_mem[:produced])
+                    total_out += produced
+                if stream.block_state == ISAL_BLOCK_FINISH:
+                    at_member_boundary = True
+                    continue
+                if stream.avail_in == 0:
+                    break
+        return total_out
+    finally:
+        PyBuffer_Release(in_view)
+        PyBuffer_Release(out_view)
+        src_io.close()
+        dst_io.close()
+
+
+def decompress_members(data, Py_ssize_t bufsize=DEF_BUF_SIZE):
+    """
+    Decompresses a stream of concatenated gzip members in one call,
+    returning the concatenated output. The member loop runs entirely in
+    C with one reused inflate state: gzip headers are parsed by ISA-L's
+    state machine, trailer checksums and lengths are verified, and zero
+    padding between members is skipped. For files with many small
+    members this avoids all per-member Python overhead.
+
+    :param bufsize: The initial size of the output buffer.
+    """
+    if bufsize < 0:
+        raise ValueError("bufsize must be non-negative")
+
+    cdef inflate_state stream
+    isal_inflate_init(&stream)
+    stream.crc_flag = ISAL_GZIP
+
+    # initialise input
+    cdef Py_buffer buffer_data
+    cdef Py_buffer* buffer = &buffer_data
+    # Cython makes sure error is handled when acquiring buffer fails.
+    PyObject_GetBuffer(data, buffer, PyBUF_C_CONTIGUOUS)
+    cdef Py_ssize_t ibuflen = buffer.len
+    stream.next_in = <unsigned char*>buffer.buf
+    stream.avail_out = 0
+
+    cdef unsigned char * obuf = NULL
+    cdef int err
+    # Set after a member (including its trailer) has been verified; the
+    # next non-zero input byte then starts a new member.
+    cdef bint at_member_boundary = False
+
+    try:
+        while True:
+            arrange_input_buffer(&stream, &ibuflen)
+
+            while True:
+                if at_member_boundary:
+                    # Skip zero padding between members.
+                    with nogil:
+                        while (stream.avail_in > 0 and
+                               stream.next_in[0] == 0):
+                            stream.next_in += 1
+                            stream.avail_in -= 1
+                    if stream.avail_in == 0:
+                        break
+                    # More members follow: restart the state machine,
+                    # keeping the input position.
+                    isal_inflate_reset(&stream)
+                    stream.crc_flag = ISAL_GZIP
+                    at_member_boundary = False
+                bufsize = arrange_output_buffer(&stream, &obuf, bufsize)
+                if bufsize == -1:
+                    raise MemoryError("Unsufficient memory for buffer allocation")
+                with nogil:
+                    err = isal_inflate(&stream)
+                if err != ISAL_DECOMP_OK:
+                    check_isal_inflate_rc(err)
+                if stream.block_state == ISAL_BLOCK_FINISH:
+                    at_member_boundary = True
+                    continue
+                if stream.avail_out != 0:
+                    break
+            if ibuflen == 0:
+                break
+        if not (at_member_boundary and stream.avail_in == 0):
+            raise IsalError("incomplete or truncated stream")
+        return PyBytes_FromStringAndSize(<char*>obuf, stream.next_out - obuf)
+    finally:
+        PyBuffer_Release(buffer)
+        PyMem_Free(obuf)
+
+
+def compress_stateless(data,
+                       int level=ISAL_DEFAULT_COMPRESSION_I,
+                       int flag = IGZIP_DEFLATE,
+                       int mem_level = MEM_LEVEL_DEFAULT_I,
+                       int hist_bits = ISAL_DEF_MAX_HIST_BITS,
+                       out = None):
+    """
+    Compresses the bytes in *data* with ISA-L's stateless entry point.
+    This skips the streaming state setup and flush handling, which
+    dominates the cost of compressing small (sub-4 KiB) payloads.
+
+    The entire input is compressed in one call; inputs larger than 4 GiB
+    are rejected. When *out* (a writable buffer-protocol object) is
+    given the result is written into it and the number of bytes produced
+    is returned, otherwise a new bytes object is returned.
+
+    The other parameters are the same as for compress.
+    """
+    # initialise input
+    cdef Py_buffer in_buffer_data
+    cdef Py_buffer* in_buffer = &in_buffer_data
+    # Cython makes sure error is handled when acquiring buffer fails.
+    PyObject_GetBuffer(data, in_buffer, PyBUF_C_CONTIGUOUS)
+    cdef Py_ssize_t ibuflen = in_buffer.len
+    if ibuflen > UINT32_MAX:
+        PyBuffer_Release(in_buffer)
+        raise OverflowError("Data too big for stateless compression")
+
+    if not (ISAL_DEF_MIN_LEVEL <= level <= ISAL_DEF_MAX_LEVEL):
+        PyBuffer_Release(in_buffer)
+        raise ValueError("Invalid compression level.")
+    cdef isal_zstream stream
+    cdef unsigned int level_buf_size
+    if mem_level_to_bufsize(level, mem_level, &level_buf_size) != 0:
+        PyBuffer_Release(in_buffer)
+        raise ValueError("Invalid memory level: {0}".format(mem_level))
+    cdef unsigned char* level_buf = <unsigned char*> PyMem_Malloc(level_buf_size * sizeof(char))
+    isal_deflate_stateless_init(&stream)
+    stream.level = level
+    stream.level_buf = level_buf
+    stream.level_buf_size = level_buf_size
+    stream.hist_bits = hist_bits
+    stream.gzip_flag = flag
+    stream.flush = NO_FLUSH
+    stream.end_of_stream = 1
+    stream.next_in = <unsigned char*>in_buffer.buf
+    stream.avail_in = <unsigned int>ibuflen
+
+    # Worst case bound: deflate stores incompressible data with a small
+    # per-block overhead, plus room for the largest header and trailer.
+    cdef Py_ssize_t bound = ibuflen + (ibuflen >> 9) + 100
+    cdef unsigned char * obuf = NULL
+    cdef Py_buffer out_buffer_data
+    cdef Py_buffer* out_buffer = &out_buffer_data
+    cdef bint out_acquired = False
+    cdef int err
+    try:
+        if out is None:
+            obuf = <unsigned char *>PyMem_Malloc(bound * sizeof(char))
+            if obuf is NULL:
+                raise MemoryError("Unsufficient memory for buffer allocation")
+            stream.next_out = obuf
+            stream.avail_out = <unsigned int>py_ssize_t_min(bound, UINT32_MAX)
+        else:
+            PyObject_GetBuffer(out, out_buffer,
+                               PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE)
+            out_acquired = True
+            stream.next_out = <unsigned char*>out_buffer.buf
+            stream.avail_out = <unsigned int>py_ssize_t_min(out_buffer.len,
+                                                            UINT32_MAX)
+        with nogil:
+            err = isal_deflate_stateless(&stream)
+        if err != COMP_OK:
+            check_isal_deflate_rc(err)
+        if out is None:
+            return PyBytes_FromStringAndSize(
+                <char*>obuf, stream.next_out - obuf)
+        return stream.next_out - <unsigned char*>out_buffer.buf
+    finally:
+        if out_acquired:
+            PyBuffer_Release(out_buffer)
+        PyMem_Free(obuf)
+        PyMem_Free(level_buf)
+        PyBuffer_Release(in_buffer)
+
+
+def decompress_stateless(data,
+                         int flag = ISAL_DEFLATE,
+                         int hist_bits=ISAL_DEF_MAX_HIST_BITS,
+                         Py_ssize_t bufsize=DEF_BUF_SIZE,
+                         out = None):
+    """
+    Decompresses the bytes in *data* with a single inflate call and no
+    output buffer growth, for one-shot use on small payloads where the
+    caller knows the output size.
+
+    When *out* (a writable buffer-protocol object) is given the result
+    is written into it and the number of bytes produced is returned.
+    Otherwise a bytes object is returned and *bufsize* must be large
+    enough for the entire output; an IsalError is raised when it is not.
+
+    The *flag* and *hist_bits* parameters are the same as for decompress.
+    """
+    if bufsize < 0:
+        raise ValueError("bufsize must be non-negative")
+    if bufsize > UINT32_MAX:
+        raise OverflowError("bufsize does not fit in an unsigned int")
+
+    # initialise input
+    cdef Py_buffer in_buffer_data
+    cdef Py_buffer* in_buffer = &in_buffer_data
+    # Cython makes sure error is handled when acquiring buffer fails.
+    PyObject_GetBuffer(data, in_buffer, PyBUF_C_CONTIGUOUS)
+    if in_buffer.len > UINT32_MAX:
+        PyBuffer_Release(in_buffer)
+        raise OverflowError("Data too big for stateless decompression")
+
+    cdef inflate_state stream
+    isal_inflate_init(&stream)
+    stream.hist_bits = hist_bits
+    stream.crc_flag = flag
+    stream.next_in = <unsigned char*>in_buffer.buf
+    stream.avail_in = <unsigned int>in_buffer.len
+
+    cdef unsigned char * obuf = NULL
+    cdef Py_buffer out_buffer_data
+    cdef Py_buffer* out_buffer = &out_buffer_data
+    cdef bint out_acquired = False
+    cdef int err
+    try:
+        if out is None:
+            obuf = <unsigned char *>PyMem_Malloc(bufsize * sizeof(char))
+            if obuf is NULL:
+                raise MemoryError("Unsufficient memory for buffer allocation")
+            stream.next_out = obuf
+            stream.avail_out = <unsigned int>bufsize
+        else:
+            PyObject_GetBuffer(out, out_buffer,
+                               PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE)
+            out_acquired = True
+            stream.next_out = <unsigned char*>out_buffer.buf
+            stream.avail_out = <unsigned int>py_ssize_t_min(out_buffer.len,
+                                                            UINT32_MAX)
+        with nogil:
+            err = isal_inflate(&stream)
+        if err != ISAL_DECOMP_OK:
+            check_isal_inflate_rc(err)
+        if stream.block_state != ISAL_BLOCK_FINISH:
+            if stream.avail_out == 0:
+                raise IsalError("Not enough room in output buffer")
+            raise IsalError("incomplete or truncated stream")
+        if out is None:
+            return PyBytes_FromStringAndSize(
+                <char*>obuf, stream.next_out - obuf)
+        return stream.next_out - <unsigned char*>out_buffer.buf
+    finally:
+        if out_acquired:
+            PyBuffer_Release(out_buffer)
+        PyMem_Free(obuf)
+        PyBuffer_Release(in_buffer)
+
+
+def decompress_chunks(data,
+                      int flag = ISAL_DEFLATE,
+                      int hist_bits=ISAL_DEF_MAX_HIST_BITS,
+                      Py_ssize_t chunk_size=512 * 1024):
+    """
+    Decompresses the bytes in *data* into a list of bytes objects of at
+    most *chunk_size* each. Unlike decompress, the output is never grown
+    by realloc-and-copy and at no point is more than one chunk of extra
+    memory held, which makes this the preferred interface for large
+    one-shot decompressions. Use b"".join(result) when contiguous output
+    is required.
+
+    The *flag* and *hist_bits* parameters are the same as for decompress.
+    """
+    if chunk_size < 1:
+        raise ValueError("chunk_size must be at least 1")
+    if chunk_size > UINT32_MAX:
+        raise ValueError("chunk_size does not fit in an unsigned int")
+
+    cdef inflate_state stream
+    isal_inflate_init(&stream)
+    stream.hist_bits = hist_bits
+    stream.crc_flag = flag
+
+    # initialise input
+    cdef Py_buffer buffer_data
+    cdef Py_buffer* buffer = &buffer_data
+    # Cython makes sure error is handled when acquiring buffer fails.
+    PyObject_GetBuffer(data, buffer, PyBUF_C_CONTIGUOUS)
+    cdef Py_ssize_t ibuflen = buffer.len
+    stream.next_in =  <unsigned char*>buffer.buf
+    stream.avail_out = 0
+
+    cdef list chunks = []
+    cdef object chunk = None
+    cdef Py_ssize_t occupied
+    cdef int err
+
+    try:
+        while True:
+            arrange_input_buffer(&stream, &ibuflen)
+
+            while True:
+                if stream.avail_out == 0:
+                    # The current chunk is full (or this is the first
+                    # iteration): store it and write into a fresh one. The
+                    # chunk is created uninitialized and only exposed after
+                    # it has been filled.
+                    if chunk is not None:
+                        chunks.append(chunk)
+                    chunk = PyBytes_FromStringAndSize(NULL, chunk_size)
+                    stream.next_out = <unsigned char *>PyBytes_AS_STRING(
+                        chunk)
+                    stream.avail_out = <unsigned int>chunk_size
+                with nogil:
+                    err = isal_inflate(&stream)
+                if err != ISAL_DECOMP_OK:
+                    check_isal_inflate_rc(err)
+                if stream.avail_out != 0 or stream.block_state == ISAL_BLOCK_FINISH:
+                    break
+            if ibuflen == 0 or stream.block_state == ISAL_BLOCK_FINISH:
+                break
+        if stream.block_state != ISAL_BLOCK_FINISH:
+            raise IsalError("incomplete or truncated stream")
+        if chunk is not None:
+            occupied = chunk_size - stream.avail_out
+            if occupied == chunk_size:
+                chunks.append(chunk)
+            elif occupied > 0:
+                # The last chunk is shrunk to its occupied size.
+                chunks.append(PyBytes_FromStringAndSize(
+                    PyBytes_AS_STRING(chunk), occupied))
+        return chunks
+    finally:
+        PyBuffer_Release(buffer)
+
+
+def compress_into(data, out,
+                  int level=ISAL_DEFAULT_COMPRESSION_I,
+                  int flag = IGZIP_DEFLATE,
+                  int mem_level = MEM_LEVEL_DEFAULT_I,
+                  int hist_bits = ISAL_DEF_MAX_HIST_BITS,
+                  ):
+    """
+    Compresses the bytes in *data* directly into the writable buffer *out*
+    (bytearray, memoryview, etc.). No intermediate output buffer is
+    allocated. Returns the number of bytes written to *out*. Raises an
+    IsalError when *out* is too small to hold the compressed data.
+
+    The *level*, *flag*, *mem_level* and *hist_bits* parameters are the
+    same as for compress.
+    """
+    # initialise input
+    cdef Py_buffer in_buffer_data
+    cdef Py_buffer* in_buffer = &in_buffer_data
+    # Cython makes sure error is handled when acquiring buffer fails.
+    PyObject_GetBuffer(data, in_buffer, PyBUF_C_CONTIGUOUS)
+    cdef Py_ssize_t ibuflen = in_buffer.len
+
+    # Initialise stream. The buffers are acquired first so the level
+    # buffer can not leak when a non-buffer object is passed.
+    if not (ISAL_DEF_MIN_LEVEL <= level <= ISAL_DEF_MAX_LEVEL):
+        PyBuffer_Release(in_buffer)
+        raise ValueError("Invalid compression level.")
+    cdef isal_zstream stream
+    cdef unsigned int level_buf_size
+    if mem_level_to_bufsize(level, mem_level, &level_buf_size) != 0:
+        PyBuffer_Release(in_buffer)
+        raise ValueError("Invalid memory level: {0}".format(mem_level))
+    cdef unsigned char* level_buf = <unsigned char*> PyMem_Malloc(level_buf_size * sizeof(char))
+    isal_deflate_init(&stream)
+    stream.level = level
+    stream.level_buf = level_buf
+    stream.level_buf_size = level_buf_size
+    stream.hist_bits = hist_bits
+    stream.gzip_flag = flag
+    stream.next_in = <unsigned char*>in_buffer.buf
+
+    # initialise output from the caller's buffer
+    cdef Py_buffer out_buffer_data
+    cdef Py_buffer* out_buffer = &out_buffer_data
+    try:
+        PyObject_GetBuffer(out, out_buffer, PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE)
+    except BaseException:
+        PyBuffer_Release(in_buffer)
+        PyMem_Free(level_buf)
+        raise
+    cdef Py_ssize_t obuflen = out_buffer.len
+    stream.next_out = <unsigned char*>out_buffer.buf
+    stream.avail_out = 0
+
+    cdef int err
+
+    try:
+        while True:
+            arrange_input_buffer(&stream, &ibuflen)
+            if ibuflen == 0:
+                stream.flush = FULL_FLUSH
+                stream.end_of_stream = 1
+            else:
+                stream.flush = NO_FLUSH
+
+            while True:
+                if stream.avail_out == 0:
+                    if obuflen == 0:
+                        raise IsalError("Not enough room in output buffer")
+                    # The output window is replenished in chunks of at most
+                    # UINT32_MAX so any buffer size can be used.
+                    stream.avail_out = <unsigned int>py_ssize_t_min(
+                        obuflen, UINT32_MAX)
+                    obuflen -= stream.avail_out
+                with nogil:
+                    err = isal_deflate(&stream)
+                if err != COMP_OK:
+                    check_isal_deflate_rc(err)
+                if (stream.internal_state.state == ZSTATE_END or
+                        stream.avail_out != 0):
+                    break
+            if stream.avail_in != 0:
+                raise AssertionError("Input stream should be empty")
+            if stream.internal_state.state == ZSTATE_END:
+                break
+        return stream.next_out - <unsigned char*>out_buffer.buf
+    finally:
+        PyBuffer_Release(in_buffer)
+        PyBuffer_Release(out_buffer)
+        PyMem_Free(level_buf)
+
+
+def decompress_into(data, out,
+                    int flag = ISAL_DEFLATE,
+                    int hist_bits=ISAL_DEF_MAX_HIST_BITS):
+    """
+    Decompresses the bytes in *data* directly into the writable buffer
+    *out* (bytearray, memoryview, etc.). No intermediate output buffer is
+    allocated. Returns the number of bytes written to *out*. Raises an
+    IsalError when *out* is too small to hold the decompressed data.
+
+    The *flag* and *hist_bits* parameters are the same as for decompress.
+    """
+    cdef inflate_state stream
+    isal_inflate_init(&stream)
+    stream.hist_bits = hist_bits
+    stream.crc_flag = flag
+
+    # initialise input
+    cdef Py_buffer in_buffer_data
+    cdef Py_buffer* in_buffer = &in_buffer_data
+    # Cython makes sure error is handled when acquiring buffer fails.
+    PyObject_GetBuffer(data, in_buffer, PyBUF_C_CONTIGUOUS)
+    cdef Py_ssize_t ibuflen = in_buffer.len
+    stream.next_in =  <unsigned char*>in_buffer.buf
+
+    # initialise output from the caller's buffer
+    cdef Py_buffer out_buffer_data
+    cdef Py_buffer* out_buffer = &out_buffer_data
+    try:
+        PyObject_GetBuffer(out, out_buffer, PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE)
+    except BaseException:
+        PyBuffer_Release(in_buffer)
+        raise
+    cdef Py_ssize_t obuflen = out_buffer.len
+    stream.next_out = <unsigned char*>out_buffer.buf
+    stream.avail_out = 0
+
+    cdef int err
+    cdef unsigned int prev_avail_in
+
+    try:
+        while True:
+            arrange_input_buffer(&stream, &ibuflen)
+
+            while True:
+                if stream.avail_out == 0 and obuflen > 0:
+                    # The output window is replenished in chunks of at most
+                    # UINT32_MAX so any buffer size can be used.
+                    stream.avail_out = <unsigned int>py_ssize_t_min(
+                        obuflen, UINT32_MAX)
+                    obuflen -= stream.avail_out
+                prev_avail_in = stream.avail_in
+                with nogil:
+                    err = isal_inflate(&stream)
+                if err != ISAL_DECOMP_OK:
+                    check_isal_inflate_rc(err)
+                if (stream.block_state == ISAL_BLOCK_FINISH or
+                        stream.avail_out != 0):
+                    break
+                if obuflen == 0:
+                    if stream.avail_in == 0:
+                        # More input may still arrive in the outer loop.
+                        break
+                    if stream.avail_in == prev_avail_in:
+                        # Input remains but no progress can be made:
+                        # the output buffer is full.
+                        raise IsalError("Not enough room in output buffer")
+            if ibuflen == 0 or stream.block_state == ISAL_BLOCK_FINISH:
+                break
+        if stream.block_state != ISAL_BLOCK_FINISH:
+            raise IsalError("incomplete or truncated stream")
+        return stream.next_out - <unsigned char*>out_buffer.buf
+    finally:
+        PyBuffer_Release(in_buffer)
+        PyBuffer_Release(out_buffer)
+
+
+cdef class HuffmanTables:
+    """Custom Huffman tables created by train_hufftables. Can be passed
+    to the hufftables parameter of compress to improve the compression
+    ratio of level 0 compression for a specific kind of data."""
+    # self.hufftables stays NULL until train_hufftables fills it, so a
+    # directly instantiated object can never hand uninitialized tables
+    # to isal_deflate.
+
+    def __dealloc__(self):
+        if self.hufftables is not NULL:
+            PyMem_Free(self.hufftables)
+
+
+def train_hufftables(sample_data):
+    """
+    Train custom Huffman tables on *sample_data* and return a
+    HuffmanTables object. Compressing with trained tables gives level 0
+    speed with a ratio that approaches dynamic Huffman coding when the
+    compressed data resembles the sample.
+
+    :param sample_data: A representative sample of the data that will be
+                        compressed with the resulting tables.
+    """
+    cdef Py_buffer buffer_data
+    cdef Py_buffer* buffer = &buffer_data
+    # Cython makes sure error is handled when acquiring buffer fails.
+    PyObject_GetBuffer(sample_data, buffer, PyBUF_C_CONTIGUOUS)
+
+    cdef isal_huff_histogram *histogram = <isal_huff_histogram *>PyMem_Malloc(
+        sizeof(isal_huff_histogram))
+    if histogram is NULL:
+        PyBuffer_Release(buffer)
+        raise MemoryError("Unsufficient memory for buffer allocation")
+    memset(histogram, 0, sizeof(isal_huff_histogram))
+
+    # isal_update_histogram takes an int length, so the sample is fed in
+    # chunks. Multiple calls accumulate into the same histogram.
+    cdef unsigned char * sample = <unsigned char *>buffer.buf
+    cdef Py_ssize_t remaining = buffer.len
+    cdef int chunk
+    cdef int err
+    cdef HuffmanTables tables
+    try:
+        while remaining > 0:
+            chunk = <int>py_ssize_t_min(remaining, 1 << 30)
+            with nogil:
+                isal_update_histogram(sample, chunk, histogram)
+            sample += chunk
+            remaining -= chunk
+        tables = HuffmanTables()
+        tables.hufftables = <isal_hufftables *>PyMem_Malloc(
+            sizeof(isal_hufftables))
+        if tables.hufftables is NULL:
+            raise MemoryError("Unsufficient memory for buffer allocation")
+        err = isal_create_hufftables(tables.hufftables, histogram)
+        if err != COMP_OK:
+            check_isal_deflate_rc(err)
+        return tables
+    finally:
+        PyMem_Free(histogram)
+        PyBuffer_Release(buffer)
+
+
+cdef class PreparedDict:
+    """
+    A compression dictionary that is preprocessed once and can be applied
+    to many compression streams. Passing a PreparedDict as zdict to
+    isal_zlib.compressobj replaces the per-stream dictionary hashing with
+    a copy of the precomputed tables.
+
+    The dictionary is processed for one compression level (and the
+    default memory level); the compression streams it is applied to must
+    use the same settings.
+
+    :param dictionary: The dictionary data. If longer than the history
+                       size only the last part is used.
+    :param level: The compression level to preprocess for.
+    """
+    def __cinit__(self,
+                  dictionary,
+                  int level=ISAL_DEFAULT_COMPRESSION_I):
+        if not (ISAL_DEF_MIN_LEVEL <= level <= ISAL_DEF_MAX_LEVEL):
+            raise ValueError("Invalid compression level.")
+        self.dictionary = bytes(dictionary)
+        cdef Py_ssize_t length = len(self.dictionary)
+        if length > UINT32_MAX:
+            raise OverflowError(
+                "dictionary length does not fit in an unsigned int")
+        self.level = level
+        self.processed = <isal_dict *>PyMem_Malloc(sizeof(isal_dict))
+        if self.processed is NULL:
+            raise MemoryError("Unsufficient memory for buffer allocation")
+
+        # Processing needs a stream with the target level and a level
+        # buffer, it determines the hash sizes of the processed tables.
+        cdef isal_zstream stream
+        cdef unsigned int level_buf_size
+        mem_level_to_bufsize(level, MEM_LEVEL_DEFAULT_I, &level_buf_size)
+        cdef unsigned char *level_buf = <unsigned char *>PyMem_Malloc(
+            level_buf_size * sizeof(char))
+        if level_buf is NULL:
+            raise MemoryError("Unsufficient memory for buffer allocation")
+        isal_deflate_init(&stream)
+        stream.level = level
+        stream.level_buf = level_buf
+        stream.level_buf_size = level_buf_size
+        cdef int err
+        try:
+            err = isal_deflate_process_dict(&stream, self.processed,
+                                            self.dictionary, length)
+            if err != COMP_OK:
+                check_isal_deflate_rc(err)
+        finally:
+            PyMem_Free(level_buf)
+
+    def __dealloc__(self):
+        if self.processed is not NULL:
+            PyMem_Free(self.processed)
+
+
+cdef class IgzipDecompressor:
+    """
+    Decompressor object for handling streaming decompression. The interface
+    is modelled on bz2.BZ2Decompressor: unconsumed input is retained inside
+    the object, headers are parsed and trailer checksums are verified by
+    ISA-L, so a reader loop needs only one call into C per chunk of input.
+
+    :param flag: Whether the compressed block contains headers and/or
+                 trailers and of which type. Can be any of: DECOMP_DEFLATE
+                 (default), DECOMP_GZIP, DECOMP_GZIP_NO_HDR,
+                 DECOMP_GZIP_NO_HDR_VER, DECOMP_ZLIB, DECOMP_ZLIB_NO_HDR,
+                 DECOMP_ZLIB_NO_HDR_VER.
+    :param hist_bits: Sets the size of the view window. The size equals
+                      2^hist_bits.
+    :param zdict: A predefined compression dictionary. Must be the same
+                  zdict as was used to compress the data.
+    """
+    cdef inflate_state stream
+    cdef unsigned char * input_buffer
+    cdef Py_ssize_t input_buffer_size
+    cdef Py_ssize_t avail_in_real
+    cdef public bint eof
+    cdef public bint needs_input
+    cdef public bytes unused_data
+    # Protects the stream state, the GIL is released during isal_inflate.
+    cdef object lock
+
+    def __cinit__(self,
+                  int flag = ISAL_DEFLATE,
+                  int hist_bits = ISAL_DEF_MAX_HIST_BITS,
+                  zdict = None):
+        self.lock = threading.Lock()
+        isal_inflate_init(&self.stream)
+        self.stream.hist_bits = hist_bits
+        self.stream.crc_flag = flag
+        self.stream.next_in = NULL
+        self.input_buffer = NULL
+        self.input_buffer_size = 0
+        self.avail_in_real = 0
+        self.eof = False
+        self.needs_input = True
+        self.unused_data = b""
+
+        cdef Py_ssize_t zdict_length
+        if zdict:
+            zdict_length = len(zdict)
+            if zdict_length > UINT32_MAX:
+                raise OverflowError("zdict length does not fit in an unsigned int")
+            err = isal_inflate_set_dict(&self.stream, zdict, zdict_length)
+            if err != COMP_OK:
+                check_isal_inflate_rc(err)
+
+    def __dealloc__(self):
+        if self.input_buffer is not NULL:
+            PyMem_Free(self.input_buffer)
+
+    @property
+    def crc(self):
+        """The checksum that is saved if DECOMP_ZLIB* or DECOMP_GZIP*
+        flags are used."""
+        return self.stream.crc
+
+    cdef bytes decompress_buf(self,
+                              Py_ssize_t max_length,
+                              bint *max_length_reached,
+                              Py_ssize_t size_hint):
+        """Decompress from self.stream.next_in/self.avail_in_real. Updates
+        self.avail_in_real and self.eof. The stream's next_in points at the
+        unconsumed input afterwards."""
+        cdef Py_ssize_t hard_limit
+        if max_length < 0:
+            hard_limit = PY_SSIZE_T_MAX
+        else:
+            hard_limit = max_length
+
+        cdef unsigned char * obuf = NULL
+        cdef Py_ssize_t obuflen
+        if size_hint > 0:
+            # When the caller knows the output size (for example from the
+            # gzip trailer's ISIZE field) the output buffer is allocated
+            # in one go and is never grown by realloc-and-copy.
+            obuflen = size_hint
+        else:
+            obuflen = DEF_BUF_SIZE_I
+        if obuflen > hard_limit:
+            obuflen = hard_limit
+        cdef Py_ssize_t ibuflen = self.avail_in_real
+        cdef int err
+        try:
+            while True:
+                arrange_input_buffer(&self.stream, &ibuflen)
+                while True:
+                    obuflen = arrange_output_buffer_with_maximum(
+                              &self.stream, &obuf, obuflen, hard_limit)
+                    if obuflen == -1:
+                        raise MemoryError("Unsufficient memory for buffer allocation")
+                    elif obuflen == -2:
+                        max_length_reached[0] = True
+                        break
+                    with nogil:
+                        err = isal_inflate(&self.stream)
+                    if err != ISAL_DECOMP_OK:
+                        check_isal_inflate_rc(err)
+                    if self.stream.block_state == ISAL_BLOCK_FINISH or self.stream.avail_out != 0:
+                        break
+                if self.stream.block_state == ISAL_BLOCK_FINISH:
+                    self.eof = 1
+                    break
+                if ibuflen == 0 or max_length_reached[0]:
+                    break
+            self.avail_in_real = ibuflen + self.stream.avail_in
+            return PyBytes_FromStringAndSize(<char*>obuf, self.stream.next_out - obuf)
+        finally:
+            PyMem_Free(obuf)
+
+    def decompress(self, data, Py_ssize_t max_length = -1,
+                   Py_ssize_t size_hint = 0):
+        """
+        Decompress *data*, returning uncompressed data as bytes.
+
+        If *max_length* is nonnegative, returns at most *max_length* bytes
+        of decompressed data. If this limit is reached and further output
+        can be produced, the needs_input attribute will be set to False. In
+        this case, the next call to decompress may provide data as b'' to
+        obtain more of the output.
+
+        *size_hint* sets the initial size of the output buffer for this
+        call. When it is the exact output size, no output buffer resizing
+        takes place.
+
+        If all of the input data was decompressed and returned (either
+        because this was less than max_length bytes, or because max_length
+        was negative), the needs_input attribute will be set to True.
+
+        Attempting to decompress data after the end of stream is reached
+        raises an EOFError. Any data found after the end of the stream is
+        ignored and saved in the unused_data attribute.
+        """
+        if self.eof:
+            raise EOFError("End of stream already reached")
+
+        cdef Py_buffer buffer_data
+        cdef Py_buffer* buffer = &buffer_data
+        # Cython makes sure error is handled when acquiring buffer fails.
+        PyObject_GetBuffer(data, buffer, PyBUF_C_CONTIGUOUS)
+
+        cdef bint input_buffer_in_use
+        cdef bint max_length_reached = False
+        cdef unsigned char * tmp
+        cdef Py_ssize_t offset, avail_now, avail_total, new_size
+
+        self.lock.acquire()
+        try:
+            # Prepend unconsumed input if necessary.
+            if self.stream.next_in is not NULL and self.avail_in_real > 0:
+                # The unconsumed input lives in self.input_buffer.
+                offset = self.stream.next_in - self.input_buffer
+                avail_now = (self.input_buffer_size - offset -
+                             self.avail_in_real)
+                avail_total = self.input_buffer_size - self.avail_in_real
+                if avail_total < buffer.len:
+                    new_size = self.avail_in_real + buffer.len
+                    tmp = <unsigned char *>PyMem_Malloc(new_size)
+                    if tmp is NULL:
+                        raise MemoryError(
+                            "Unsufficient memory for buffer allocation")
+                    memcpy(tmp, self.stream.next_in, self.avail_in_real)
+                    PyMem_Free(self.input_buffer)
+                    self.input_buffer = tmp
+                    self.input_buffer_size = new_size
+                    self.stream.next_in = self.input_buffer
+                elif avail_now < buffer.len:
+                    memmove(self.input_buffer, self.stream.next_in,
+                            self.avail_in_real)
+                    self.stream.next_in = self.input_buffer
+                if buffer.len > 0:
+                    memcpy(self.stream.next_in + self.avail_in_real,
+                           buffer.buf, buffer.len)
+                self.avail_in_real += buffer.len
+                input_buffer_in_use = True
+            else:
+                self.stream.next_in = <unsigned char*>buffer.buf
+                self.avail_in_real = buffer.len
+                input_buffer_in_use = False
+
+            try:
+                result = self.decompress_buf(max_length, &max_length_reached,
+                                             size_hint)
+            except Exception:
+                # The stream is in an undefined state after an error. Drop
+                # the leftover input so next_in can not be dereferenced
+                # after the caller's buffer is released.
+                self.stream.next_in = NULL
+                self.avail_in_real = 0
+                raise
+
+            if self.eof:
+                self.needs_input = False
+                # Recover the bits left in the bitbuffer and any trailing
+                # input that was not consumed.
+                self.unused_data = view_bitbuffer(&self.stream)
+                if self.avail_in_real > 0:
+                    self.unused_data += PyBytes_FromStringAndSize(
+                        <char *>self.stream.next_in, self.avail_in_real)
+            elif self.avail_in_real == 0:
+                # All retained input was consumed: more input is needed
+                # to make progress, even when the output limit was hit
+                # (same protocol as bz2.BZ2Decompressor). Pending internal
+                # output, if any, is produced by the next call regardless
+                # of what it is fed.
+                self.stream.next_in = NULL
+                self.needs_input = True
+            else:
+                # More input is only needed when no output limit was hit.
+                self.needs_input = not max_length_reached
+                if not input_buffer_in_use:
+                    # Copy the leftover input to an internal buffer so it
+                    # survives past this call.
+                    if self.input_buffer_size < self.avail_in_real:
+                        if self.input_buffer is not NULL:
+                            PyMem_Free(self.input_buffer)
+                        self.input_buffer = <unsigned char *>PyMem_Malloc(
+                            self.avail_in_real)
+                        if self.input_buffer is NULL:
+                            self.input_buffer_size = 0
+                            raise MemoryError(
+                                "Unsufficient memory for buffer allocation")
+                        self.input_buffer_size = self.avail_in_real
+                    memcpy(self.input_buffer, self.stream.next_in,
+                           self.avail_in_real)
+                    self.stream.next_in = self.input_buffer
+            return result
+        finally:
+            self.lock.release()
+            PyBuffer_Release(buffer)
+
+    cdef Py_ssize_t decompress_into_buf(self,
+                                        unsigned char *obuf,
+                                        Py_ssize_t obuflen,
+                                        bint *output_full) except -1:
+        """Decompress from self.stream.next_in/self.avail_in_real into a
+        fixed caller buffer. Returns the number of bytes written and
+        updates self.avail_in_real and self.eof."""
+        cdef Py_ssize_t ibuflen = self.avail_in_real
+        cdef Py_ssize_t remaining_out = obuflen
+        cdef int err
+        self.stream.next_out = obuf
+        self.stream.avail_out = 0
+        while True:
+            arrange_input_buffer(&self.stream, &ibuflen)
+            while True:
+                if self.stream.avail_out == 0:
+                    if remaining_out == 0:
+                        output_full[0] = True
+                        break
+                    # The output window is replenished in chunks of at
+                    # most UINT32_MAX so any buffer size can be used.
+                    self.stream.avail_out = <unsigned int>py_ssize_t_min(
+                        remaining_out, UINT32_MAX)
+                    remaining_out -= self.stream.avail_out
+                with nogil:
+                    err = isal_inflate(&self.stream)
+                if err != ISAL_DECOMP_OK:
+                    check_isal_inflate_rc(err)
+                if (self.stream.block_state == ISAL_BLOCK_FINISH or
+                        self.stream.avail_out != 0):
+                    break
+            if self.stream.block_state == ISAL_BLOCK_FINISH:
+                self.eof = 1
+                break
+            if ibuflen == 0 or output_full[0]:
+                break
+        remaining_out += self.stream.avail_out
+        self.avail_in_real = ibuflen + self.stream.avail_in
+        return obuflen - remaining_out
+
+    def decompress_into(self, data, out):
+        """
+        Decompress *data* directly into the writable buffer *out* and
+        return the number of bytes written. Behaves like
+        decompress(data, max_length=len(out)) except that no output is
+        allocated: input retention, needs_input, eof and unused_data work
+        exactly the same.
+        """
+        if self.eof:
+            raise EOFError("End of stream already reached")
+
+        cdef Py_buffer in_buffer_data
+        cdef Py_buffer* in_buffer = &in_buffer_data
+        # Cython makes sure error is handled when acquiring buffer fails.
+        PyObject_GetBuffer(data, in_buffer, PyBUF_C_CONTIGUOUS)
+        cdef Py_buffer out_buffer_data
+        cdef Py_buffer* out_buffer = &out_buffer_data
+        try:
+            PyObject_GetBuffer(out, out_buffer,
+                               PyBUF_C_CONTIGUOUS | PyBUF_WRITABLE)
+        except BaseException:
+            PyBuffer_Release(in_buffer)
+            raise
+
+        cdef bint input_buffer_in_use
+        cdef bint output_full = False
+        cdef unsigned char * tmp
+        cdef Py_ssize_t offset, avail_now, avail_total, new_size
+        cdef Py_ssize_t written
+
+        self.lock.acquire()
+        try:
+            # Prepend unconsumed input if necessary.
+            if self.stream.next_in is not NULL and self.avail_in_real > 0:
+                # The unconsumed input lives in self.input_buffer.
+                offset = self.stream.next_in - self.input_buffer
+                avail_now = (self.input_buffer_size - offset -
+                             self.avail_in_real)
+                avail_total = self.input_buffer_size - self.avail_in_real
+                if avail_total < in_buffer.len:
+                    new_size = self.avail_in_real + in_buffer.len
+                    tmp = <unsigned char *>PyMem_Malloc(new_size)
+                    if tmp is NULL:
+                        raise MemoryError(
+                            "Unsufficient memory for buffer allocation")
+                    memcpy(tmp, self.stream.next_in, self.avail_in_real)
+                    PyMem_Free(self.input_buffer)
+                    self.input_buffer = tmp
+                    self.input_buffer_size = new_size
+                    self.stream.next_in = self.input_buffer
+                elif avail_now < in_buffer.len:
+                    memmove(self.input_buffer, self.stream.next_in,
+                            self.avail_in_real)
+                    self.stream.next_in = self.input_buffer
+                if in_buffer.len > 0:
+                    memcpy(self.stream.next_in + self.avail_in_real,
+                           in_buffer.buf, in_buffer.len)
+                self.avail_in_real += in_buffer.len
+                input_buffer_in_use = True
+            else:
+                self.stream.next_in = <unsigned char*>in_buffer.buf
+                self.avail_in_real = in_buffer.len
+                input_buffer_in_use = False
+
+            try:
+                written = self.decompress_into_buf(
+                    <unsigned char*>out_buffer.buf, out_buffer.len,
+                    &output_full)
+            except Exception:
+                # The stream is in an undefined state after an error. Drop
+                # the leftover input so next_in can not be dereferenced
+                # after the caller's buffer is released.
+                self.stream.next_in = NULL
+                self.avail_in_real = 0
+                raise
+
+            if self.eof:
+                self.needs_input = False
+                # Recover the bits left in the bitbuffer and any trailing
+                # input that was not consumed.
+                self.unused_data = view_bitbuffer(&self.stream)
+                if self.avail_in_real > 0:
+                    self.unused_data += PyBytes_FromStringAndSize(
+                        <char *>self.stream.next_in, self.avail_in_real)
+            elif self.avail_in_real == 0:
+                # All retained input was consumed: more input is needed
+                # to make progress, even when the output buffer filled up
+                # (same protocol as decompress). Pending internal output,
+                # if any, is produced by the next call regardless of what
+                # it is fed.
+                self.stream.next_in = NULL
+                self.needs_input = True
+            else:
+                # More input is only needed when the output buffer did
+                # not fill up.
+                self.needs_input = not output_full
+                if not input_buffer_in_use:
+                    # Copy the leftover input to an internal buffer so it
+                    # survives past this call.
+                    if self.input_buffer_size < self.avail_in_real:
+                        if self.input_buffer is not NULL:
+                            PyMem_Free(self.input_buffer)
+                        self.input_buffer = <unsigned char *>PyMem_Malloc(
+                            self.avail_in_real)
+                        if self.input_buffer is NULL:
+                            self.input_buffer_size = 0
+                            raise MemoryError(
+                                "Unsufficient memory for buffer allocation")
+                        self.input_buffer_size = self.avail_in_real
+                    memcpy(self.input_buffer, self.stream.next_in,
+                           self.avail_in_real)
+                    self.stream.next_in = self.input_buffer
+            return written
+        finally:
+            self.lock.release()
+            PyBuffer_Release(in_buffer)
+            PyBuffer_Release(out_buffer)
+
+
+
 cdef bytes view_bitbuffer(inflate_state * stream):
 
         cdef int bits_in_buffer = stream.read_in_length
@@ -0,0 +1,478 @@
+# Copyright (c) 2020 Leiden University Medical Center
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Read and write gzip streams using multiple threads. On the write side the
+input is split into blocks which are compressed by a pool of worker threads.
+The compressed blocks are written to the output file in order, so the result
+is a normal single-member gzip stream that can be read by igzip.open and by
+other gzip programs. On the read side members of a multi-member gzip stream
+are decompressed concurrently."""
+
+import io
+import queue
+import struct
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+from itertools import islice
+
+from . import igzip, isal_zlib
+
+__all__ = ["ThreadedGzipReader", "ThreadedGzipWriter", "open"]
+
+# A deflate stream can refer back at most 32K. Providing the last 32K of the
+# previous block as a dictionary to the compressor retains the compression
+# ratio of a single continuous stream.
+DEFLATE_WINDOW_SIZE = 2 ** 15
+
+DEFAULT_BLOCK_SIZE = 1024 * 1024
+
+
+def open(filename, mode="rb", compresslevel=igzip._COMPRESS_LEVEL_TRADEOFF,
+         encoding=None, errors=None, newline=None, *, threads=1,
+         block_size=DEFAULT_BLOCK_SIZE):
+    """Open a gzip file for writing with multiple threads, analogous to
+    igzip.open.
+
+    When a write mode is used a ThreadedGzipWriter with *threads* compression
+    threads is returned. For read modes a buffered ThreadedGzipReader is
+    returned which decompresses the members of a multi-member gzip stream
+    concurrently.
+
+    :param threads: The number of worker threads.
+    :param block_size: The amount of bytes compressed per task when writing
+                       and the target amount of compressed bytes handled per
+                       task when reading. Larger blocks give a better
+                       compression ratio at the cost of more memory and
+                       latency.
+    """
+    if "t" in mode:
+        if "b" in mode:
+            raise ValueError("Invalid mode: %r" % (mode,))
+    else:
+        if encoding is not None:
+            raise ValueError(
+                "Argument 'encoding' not supported in binary mode")
+        if errors is not None:
+            raise ValueError("Argument 'errors' not supported in binary mode")
+        if newline is not None:
+            raise ValueError("Argument 'newline' not supported in binary mode")
+    gz_mode = mode.replace("t", "")
+    if "b" not in gz_mode:
+        gz_mode += "b"
+    # __fspath__ method is os.PathLike
+    if isinstance(filename, (str, bytes)) or hasattr(filename, "__fspath__"):
+        binary_file = io.open(filename, gz_mode)
+        closefd = True
+    elif hasattr(filename, "read") or hasattr(filename, "write"):
+        binary_file = filename
+        closefd = False
+    else:
+        raise TypeError("filename must be a str or bytes object, or a file")
+    if "r" in gz_mode:
+        raw = ThreadedGzipReader(binary_file, threads=threads,
+                                 block_size=block_size, closefd=closefd)
+        gzip_file = io.BufferedReader(raw)
+    else:
+        gzip_file = ThreadedGzipWriter(binary_file, compresslevel, threads,
+                                       block_size, closefd=closefd)
+    if "t" in mode:
+        return io.TextIOWrapper(gzip_file, encoding, errors, newline)
+    return gzip_file
+
+
+class ThreadedGzipReader(io.RawIOBase):
+    """Decompress a multi-member gzip stream using multiple threads.
+
+    The compressed stream is cut into segments at gzip member boundaries,
+    which are found by scanning for the gzip magic bytes. Each segment is
+    decompressed by a worker thread with igzip.decompress, which also
+    verifies the crc32 and length of every member. Results are delivered
+    strictly in order, so this class can be used as a raw fileobj
+    replacement for the reader in igzip.IGzipFile.
+
+    The magic byte scan can produce false positives (the magic can occur
+    inside compressed data). These are detected when decompression of the
+    segment before the false cut point fails; the segments around it are
+    then joined and decompressed again. Single-member streams decompress
+    on one thread and are buffered whole, so this reader is only an
+    improvement for multi-member files.
+    """
+    def __init__(self,
+                 fp,
+                 threads: int = 1,
+                 block_size: int = DEFAULT_BLOCK_SIZE,
+                 queue_size: int = 0,
+                 closefd: bool = False):
+        if threads < 1:
+            raise ValueError("threads should be at least 1")
+        self.raw = fp
+        self.closefd = closefd
+        self.block_size = block_size
+        self.queue_size = queue_size if queue_size > 0 else threads + 2
+        self._executor = ThreadPoolExecutor(max_workers=threads)
+        self._chunks = self._decompressed_chunks()
+        self._current = memoryview(b"")
+        self._current_pos = 0
+
+    def _raw_segments(self):
+        """Yield segments of compressed data that start at a (candidate)
+        gzip member boundary."""
+        # A bytearray is used so appending compressed data does not copy
+        # the entire accumulated buffer every read.
+        buffer = bytearray(self.raw.read(self.block_size))
+        while buffer:
+            # Only cut when at least block_size bytes have accumulated so
+            # tiny members are grouped in one decompression task.
+            pos = _find_member_candidate(buffer, self.block_size)
+            while pos == -1:
+                new_data = self.raw.read(self.block_size)
+                if not new_data:
+                    yield bytes(buffer)
+                    return
+                # Rescan only the new data, including the last three bytes
+                # of the previous chunk in case the magic is split across
+                # the chunk border.
+                scan_from = max(len(buffer) - 3, self.block_size)
+                buffer += new_data
+                pos = _find_member_candidate(buffer, scan_from)
+            yield bytes(buffer[:pos])
+            del buffer[:pos]
+
+    def _decompressed_chunks(self):
+        """Yield decompressed data per segment, in order."""
+        segments = self._raw_segments()
+        in_flight = queue.SimpleQueue()
+        submitted = 0
+        for raw_segment in islice(segments, self.queue_size):
+            in_flight.put(
+                (raw_segment, self._executor.submit(igzip.decompress,
+                                                    raw_segment)))
+            submitted += 1
+        retry = None
+        while retry is not None or submitted > 0:
+            if retry is not None:
+                raw_segment, future = retry
+                retry = None
+            else:
+                raw_segment, future = in_flight.get()
+                submitted -= 1
+            try:
+                data = future.result()
+            except (EOFError, igzip.BadGzipFile, isal_zlib.IsalError):
+                # The cut at the end of this segment was a false positive:
+                # join it with the next segment and decompress again.
+                if submitted > 0:
+                    next_segment, next_future = in_flight.get()
+                    submitted -= 1
+                    next_future.cancel()
+                else:
+                    next_segment = next(segments, None)
+                    if next_segment is None:
+                        raise
+                joined = raw_segment + next_segment
+                retry = (joined, self._executor.submit(igzip.decompress,
+                                                       joined))
+                continue
+            if data:  # Empty members decompress to b"", which is not EOF.
+                yield data
+            next_segment = next(segments, None)
+            if next_segment is not None:
+                in_flight.put(
+                    (next_segment, self._executor.submit(igzip.decompress,
+                                                         next_segment)))
+                submitted += 1
+
+    def readable(self) -> bool:
+        return True
+
+    def readinto(self, b) -> int:
+        with memoryview(b) as view:
+            if self._current_pos == len(self._current):
+                try:
+                    self._current = memoryview(next(self._chunks))
+                except StopIteration:
+                    return 0
+                self._current_pos = 0
+            length = min(view.nbytes,
+                         len(self._current) - self._current_pos)
+            view[:length] = \
+                self._current[self._current_pos:self._current_pos + length]
+            self._current_pos += length
+            return length
+
+    def close(self):
+        if self.closed:
+            return
+        self._current = memoryview(b"")
+        self._executor.shutdown()
+        if self.closefd:
+            self.raw.close()
+        super().close()
+
+
+def _find_member_candidate(buffer: bytes, start: int) -> int:
+    """Find the position of a probable gzip member start in buffer at or
+    after start. Returns -1 when none is found."""
+    pos = buffer.find(b"\x1f\x8b\x08", start)
+    while pos != -1:
+        # The three reserved bits of the flag byte must be zero in a
+        # valid gzip header; this filters most false positives.
+        if pos + 3 >= len(buffer):
+            return -1
+        if buffer[pos + 3] & 0xE0 == 0:
+            return pos
+        pos = buffer.find(b"\x1f\x8b\x08", pos + 1)
+    return -1
+
+
+class ThreadedGzipWriter(io.RawIOBase):
+    """Write a gzip stream using multiple compression threads.
+
+    The input data is divided in blocks of block_size bytes. Each block is
+    dispatched to one of the worker threads which compresses it as a raw
+    deflate stream ending in a sync flush point. A dedicated output thread
+    stitches the compressed blocks back together in order and writes them to
+    the output file. Since each block is compressed with the tail of the
+    previous block as a dictionary, the compression ratio is practically the
+    same as that of a single-threaded IGzipFile.
+
+    The crc and size bookkeeping is done on submission, so the resulting file
+    has a normal gzip trailer and is readable by igzip.open.
+    """
+    def __init__(self,
+                 fp,
+                 compresslevel: int = isal_zlib.ISAL_DEFAULT_COMPRESSION,
+                 threads: int = 1,
+                 block_size: int = DEFAULT_BLOCK_SIZE,
+                 queue_size: int = 2,
+                 closefd: bool = False):
+        if not (isal_zlib.ISAL_BEST_SPEED <= compresslevel
+                <= isal_zlib.ISAL_BEST_COMPRESSION):
+            raise ValueError(
+                "Compression level should be between {0} and {1}.".format(
+                    isal_zlib.ISAL_BEST_SPEED, isal_zlib.ISAL_BEST_COMPRESSION
+                ))
+        if threads < 1:
+            raise ValueError("threads should be at least 1")
+        if block_size < DEFLATE_WINDOW_SIZE:
+            raise ValueError("block_size should be at least {0}".format(
+                DEFLATE_WINDOW_SIZE))
+        self.raw = fp
+        self.closefd = closefd
+        self.level = compresslevel
+        self.threads = threads
+        self.block_size = block_size
+        self.lock = threading.Lock()
+        self.exception = None
+        # One input and output queue per worker thread. Submission and
+        # writing both happen round-robin over the queues, so the output
+        # order is the same as the input order.
+        self.input_queues = [queue.Queue(queue_size) for _ in range(threads)]
+        self.output_queues = [queue.Queue(queue_size) for _ in range(threads)]
+        self.index = 0
+        self.previous_block = b""
+        self.buffer = bytearray()
+        self._crc = 0
+        self._size = 0
+        self.running = False
+        self.output_worker = threading.Thread(target=self._write)
+        self.compression_workers = [
+            threading.Thread(target=self._compress, args=(i,))
+            for i in range(threads)
+        ]
+        self._write_gzip_header()
+        self._start()
+
+    def _write_gzip_header(self):
+        self.raw.write(igzip._create_simple_gzip_header(self.level))
+
+    def _start(self):
+        self.running = True
+        self.output_worker.start()
+        for worker in self.compression_workers:
+            worker.start()
+
+    def _set_error_and_empty(self, error):
+        with self.lock:
+            if self.exception is None:
+                self.exception = error
+        # Abort the pipeline. Empty the queues so no thread is left blocking
+        # on a full or empty queue.
+        for q in self.input_queues + self.output_queues:
+            while True:
+                try:
+                    q.get_nowait()
+                    q.task_done()
+                except queue.Empty:
+                    break
+
+    def _check_error(self):
+        # The exception is sticky: once the pipeline has died every
+        # subsequent write/flush/close must keep failing instead of
+        # hanging on queues nothing consumes anymore.
+        with self.lock:
+            if self.exception is not None:
+                raise self.exception
+
+    def writable(self) -> bool:
+        return True
+
+    def write(self, b) -> int:
+        self._check_error()
+        if self.closed:
+            raise ValueError("write() on closed ThreadedGzipWriter")
+        with memoryview(b) as view:
+            length = view.nbytes
+            self.buffer.extend(view)
+        while len(self.buffer) >= self.block_size:
+            block = bytes(self.buffer[:self.block_size])
+            del self.buffer[:self.block_size]
+            self._submit_block(block)
+        return length
+
+    def _submit_block(self, block: bytes):
+        # Check for errors first: when a worker has died submitted blocks
+        # are no longer consumed and the queues should not be filled further.
+        self._check_error()
+        zdict = self.previous_block[-DEFLATE_WINDOW_SIZE:]
+        self.previous_block = block
+        # The checksum is calculated over the uncompressed data on
+        # submission. Submissions are in order so no checksum combining is
+        # needed. ISA-L's crc32 is much faster than the compression itself.
+        self._crc = isal_zlib.crc32(block, self._crc)
+        self._size += len(block)
+        worker_index = self.index % self.threads
+        self.input_queues[worker_index].put((block, zdict))
+        self.index += 1
+
+    def _compress(self, index: int):
+        in_queue = self.input_queues[index]
+        out_queue = self.output_queues[index]
+        while True:
+            try:
+                block, zdict = in_queue.get(timeout=0.05)
+            except queue.Empty:
+                if not self.running or self.exception is not None:
+                    return
+                continue
+            try:
+                if zdict:
+                    compressor = isal_zlib.compressobj(
+                        self.level, wbits=-isal_zlib.MAX_WBITS, zdict=zdict)
+                else:
+                    compressor = isal_zlib.compressobj(
+                        self.level, wbits=-isal_zlib.MAX_WBITS)
+                compressed = (compressor.compress(block) +
+                              compressor.flush(isal_zlib.Z_SYNC_FLUSH))
+            except Exception as error:
+                in_queue.task_done()
+                self._set_error_and_empty(error)
+                return
+            # A timed put so a worker can not block forever on a full
+            # queue when the output thread has died.
+            while True:
+                if self.exception is not None:
+                    in_queue.task_done()
+                    return
+                try:
+                    out_queue.put(compressed, timeout=0.05)
+                    break
+                except queue.Full:
+                    continue
+            in_queue.task_done()
+
+    def _write(self):
+        index = 0
+        while True:
+            if self.exception is not None:
+                return
+            out_queue = self.output_queues[index % self.threads]
+            try:
+                compressed = out_queue.get(timeout=0.05)
+            except queue.Empty:
+                if not self.running and index == self.index:
+                    return
+                continue
+            try:
+                self.raw.write(compressed)
+            except Exception as error:
+                out_queue.task_done()
+                self._set_error_and_empty(error)
+                return
+            out_queue.task_done()
+            index += 1
+
+    def _queues_finished(self) -> bool:
+        return all(q.unfinished_tasks == 0
+                   for q in self.input_queues + self.output_queues)
+
+    def flush(self):
+        if self.closed:
+            raise ValueError("flush() on closed ThreadedGzipWriter")
+        if self.exception is not None:
+            # The pipeline died: nothing consumes the queues anymore, so
+            # joining them would hang. The stored error is raised by
+            # write() and close(); the implicit flush from IOBase.close()
+            # must be able to pass through silently.
+            return
+        # Compress the remainder of the buffer. This creates a block boundary
+        # (sync flush point) in the deflate stream, so frequent flushing
+        # slightly degrades the compression ratio.
+        if self.buffer:
+            self._submit_block(bytes(self.buffer))
+            self.buffer.clear()
+        # Wait until all submitted blocks are compressed and written,
+        # aborting when the pipeline dies in the meantime (a died thread
+        # can drop a block, in which case Queue.join() never returns).
+        while not self._queues_finished():
+            if self.exception is not None:
+                break
+            time.sleep(0.005)
+        self._check_error()
+        self.raw.flush()
+
+    def close(self):
+        if self.closed:
+            return
+        error = None
+        try:
+            self.flush()
+        except Exception as e:
+            error = e
+        self.running = False
+        for worker in self.compression_workers:
+            worker.join()
+        self.output_worker.join()
+        if error is None and self.exception is None:
+            # Write a final empty deflate block with the BFINAL bit set,
+            # followed by the gzip trailer.
+            self.raw.write(b"\x03\x00")
+            trailer = struct.pack("<II", self._crc,
+                                  self._size & 0xFFFFFFFF)
+            self.raw.write(trailer)
+            self.raw.flush()
+        # super().close() flushes, so the raw file can only be closed after.
+        super().close()
+        if self.closefd:
+            self.raw.close()
+        if error is not None:
+            raise error
+        self._check_error()
@@ -18,6 +18,8 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
+from typing import Dict
+
 ISAL_BEST_SPEED: int
 ISAL_BEST_COMPRESSION: int
 ISAL_DEFAULT_COMPRESSION: int
@@ -48,6 +50,8 @@ error: IsalError
 
 def adler32(data, value: int = 1) -> int: ...
 def crc32(data, value: int = 0) -> int: ...
+def adler32_combine(adler1: int, adler2: int, len2: int) -> int: ...
+def crc32_combine(crc1: int, crc2: int, len2: int) -> int: ...
 
 def compress(data, level: int = ISAL_DEFAULT_COMPRESSION,
              wbits: int = MAX_WBITS) -> bytes: ...
@@ -57,19 +61,31 @@ def decompress(data, wbits: int = MAX_WBITS,
 class Compress:
     def compress(self, data) -> bytes: ...
     def flush(self, mode: int = Z_FINISH) -> bytes: ...
+    def reset(self) -> None: ...
+    def copy(self) -> Compress: ...
+    def stats(self) -> Dict[str, int]: ...
 
 class Decompress:
     unused_data: bytes
     unconsumed_tail: bytes
     eof: bool
 
+    def unconsumed_tail_view(self) -> memoryview: ...
+    def unused_data_view(self) -> memoryview: ...
+    def copy(self) -> Decompress: ...
     def decompress(self, data, max_length: int = 0) -> bytes: ...
     def flush(self, length: int = DEF_BUF_SIZE) -> bytes: ...
+    def stats(self) -> Dict[str, int]: ...
 
 def compressobj(level: int = ISAL_DEFAULT_COMPRESSION,
                 method: int = DEFLATED,
                 wbits: int = MAX_WBITS,
                 memLevel: int = DEF_MEM_LEVEL,
                 strategy: int = Z_DEFAULT_STRATEGY,
-                zdict = None) -> Compress: ...
-def decompressobj(wbits: int = MAX_WBITS, zdict = None) -> Decompress: ...
+                zdict = None,
+                hufftables = None,
+                bufsize: int = DEF_BUF_SIZE,
+                max_bufsize: int = 0) -> Compress: ...
+def decompressobj(wbits: int = MAX_WBITS, zdict = None,
+                  bufsize: int = DEF_BUF_SIZE,
+                  max_bufsize: int = 0) -> Decompress: ...
@@ -51,6 +51,11 @@ Implementation of the zlib module using the ISA-L libraries.
 #     this is stored in unconsumed_tail / unused_data.
 # 11. Convert output buffer to bytes object and return.
 #
+# The isal_deflate/isal_inflate calls run in nogil blocks. All pointers they
+# touch (input buffer, output buffer, stream struct) are stable C pointers
+# acquired before the block, so multiple python threads can (de)compress
+# concurrently on multiple cores.
+#
 # Errors are raised in the main functions as much as possible to prevent cdef
 # functions returning PyObjects that need to be transformed in C variables.
 # In cases where this is not possible, C variables were set using pointers.
@@ -60,10 +65,11 @@ Implementation of the zlib module using the ISA-L libraries.
 ###############################################################################
 
 
+import threading
 import warnings
 import zlib
 
-from .crc cimport crc32_gzip_refl
+from .crc cimport crc32_gzip_refl, crc32_comb, adler32_comb
 # Import isa-l igzip-lib C constants and functions
 from .igzip_lib cimport (
     ISAL_DEF_MAX_HIST_BITS, NO_FLUSH, SYNC_FLUSH, FULL_FLUSH, IGZIP_DEFLATE,
@@ -71,7 +77,8 @@ from .igzip_lib cimport (
     ZSTATE_END, ISAL_DEFLATE, ISAL_GZIP, ISAL_ZLIB, ISAL_DEF_MIN_LEVEL,
     ISAL_DEF_MAX_LEVEL, isal_zstream, inflate_state, isal_deflate_init,
     isal_deflate_set_dict, isal_deflate, isal_inflate_init,
-    isal_inflate_set_dict, isal_inflate, isal_adler32)
+    isal_inflate_set_dict, isal_inflate, isal_adler32,
+    isal_deflate_reset_dict, PreparedDict, HuffmanTables)
 # Import python-isal igzip_lib cython functions
 from .igzip_lib cimport(
     check_isal_deflate_rc, check_isal_inflate_rc,
@@ -89,12 +96,41 @@ from . import igzip_lib
 from libc.stdint cimport UINT64_MAX, UINT32_MAX
 from cpython.mem cimport PyMem_Malloc, PyMem_Realloc, PyMem_Free
 from cpython.buffer cimport PyBUF_C_CONTIGUOUS, PyObject_GetBuffer, PyBuffer_Release
-from cpython.bytes cimport PyBytes_FromStringAndSize
+from cpython.bytes cimport PyBytes_FromStringAndSize, PyBytes_Check
 from cpython.long cimport PyLong_AsUnsignedLongMask
+from libc.string cimport memcpy
 
 cdef extern from "<Python.h>":
     const Py_ssize_t PY_SSIZE_T_MAX
 
+# A monotonic nanosecond clock for the runtime statistics, callable
+# without the GIL. Implemented directly on the platform primitives so no
+# private CPython API is needed.
+cdef extern from *:
+    """
+    #if defined(_WIN32)
+    #include <windows.h>
+    static long long isal_zlib_monotonic_ns(void) {
+        static LARGE_INTEGER frequency;
+        LARGE_INTEGER counter;
+        if (frequency.QuadPart == 0) {
+            QueryPerformanceFrequency(&frequency);
+        }
+        QueryPerformanceCounter(&counter);
+        return (long long)((double)counter.QuadPart * 1000000000.0 /
+                           (double)frequency.QuadPart);
+    }
+    #else
+    #include <time.h>
+    static long long isal_zlib_monotonic_ns(void) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (long long)ts.tv_sec * 1000000000LL + (long long)ts.tv_nsec;
+    }
+    #endif
+    """
+    long long isal_zlib_monotonic_ns() nogil
+
 ISAL_BEST_SPEED = igzip_lib.ISAL_BEST_SPEED
 ISAL_BEST_COMPRESSION = igzip_lib.ISAL_BEST_COMPRESSION
 ISAL_DEFAULT_COMPRESSION = igzip_lib.ISAL_DEFAULT_COMPRESSION
@@ -154,10 +190,15 @@ def adler32(data, value = 1):
     cdef Py_buffer* buffer = &buffer_data
     # Cython makes sure error is handled when acquiring buffer fails.
     PyObject_GetBuffer(data, buffer, PyBUF_C_CONTIGUOUS)
+    cdef unsigned int checksum
+    cdef unsigned char * buf = <unsigned char*>buffer.buf
+    cdef Py_ssize_t length = buffer.len
     try:
-        if buffer.len > UINT64_MAX:
+        if length > UINT64_MAX:
             raise ValueError("Data too big for adler32")
-        return isal_adler32(init, <unsigned char*>buffer.buf, buffer.len)
+        with nogil:
+            checksum = isal_adler32(init, buf, length)
+        return checksum
     finally:
         PyBuffer_Release(buffer)
 
@@ -174,14 +215,53 @@ def crc32(data, value = 0):
     cdef Py_buffer* buffer = &buffer_data
     # Cython makes sure error is handled when acquiring buffer fails.
     PyObject_GetBuffer(data, buffer, PyBUF_C_CONTIGUOUS)
+    cdef unsigned int checksum
+    cdef unsigned char * buf = <unsigned char*>buffer.buf
+    cdef Py_ssize_t length = buffer.len
     try:
-        if buffer.len > UINT64_MAX:
-            raise ValueError("Data too big for adler32")
-        return crc32_gzip_refl(init, <unsigned char*>buffer.buf, buffer.len)
+        if length > UINT64_MAX:
+            raise ValueError("Data too big for crc32")
+        with nogil:
+            checksum = crc32_gzip_refl(init, buf, length)
+        return checksum
     finally:
         PyBuffer_Release(buffer)
 
 
+def adler32_combine(adler1, adler2, len2):
+    """
+    Combine two Adler-32 checksums into one. Given the checksums of two
+    sequences of bytes and the length of the second sequence, returns the
+    checksum of the concatenation of both sequences.
+
+    :param adler1: The Adler-32 checksum of the first sequence.
+    :param adler2: The Adler-32 checksum of the second sequence.
+    :param len2: The length of the second sequence in bytes.
+    """
+    if len2 < 0:
+        raise ValueError("len2 can not be smaller than 0")
+    return adler32_comb(PyLong_AsUnsignedLongMask(adler1),
+                        PyLong_AsUnsignedLongMask(adler2),
+                        len2)
+
+
+def crc32_combine(crc1, crc2, len2):
+    """
+    Combine two CRC-32 checksums into one. Given the checksums of two
+    sequences of bytes and the length of the second sequence, returns the
+    checksum of the concatenation of both sequences.
+
+    :param crc1: The CRC-32 checksum of the first sequence.
+    :param crc2: The CRC-32 checksum of the second sequence.
+    :param len2: The length of the second sequence in bytes.
+    """
+    if len2 < 0:
+        raise ValueError("len2 can not be smaller than 0")
+    return crc32_comb(PyLong_AsUnsignedLongMask(crc1),
+                      PyLong_AsUnsignedLongMask(crc2),
+                      len2)
+
+
 def compress(data,
              int level=ISAL_DEFAULT_COMPRESSION_I,
              int wbits = ISAL_DEF_MAX_HIST_BITS):
@@ -234,7 +314,9 @@ def decompress(data,
 
 
 def decompressobj(int wbits=ISAL_DEF_MAX_HIST_BITS,
-                  zdict = None):
+                  zdict = None,
+                  Py_ssize_t bufsize = DEF_BUF_SIZE_I,
+                  Py_ssize_t max_bufsize = 0):
     """
     Returns a Decompress object for decompressing data streams.
 
@@ -247,8 +329,14 @@ def decompressobj(int wbits=ISAL_DEF_MAX_HIST_BITS,
                   automatically detects a gzip or zlib header.
     :zdict:       A predefined compression dictionary. Must be the same zdict
                   as was used to compress the data.
+    :param bufsize: The initial size of the per-object output buffer. The
+                    buffer is reused between calls, so steady-state
+                    streaming with a fitting bufsize does not allocate.
+    :param max_bufsize: Output buffers grown beyond this size are not
+                        retained between calls. The default of 0 means
+                        the larger of bufsize and 1 MiB.
     """
-    return Decompress.__new__(Decompress, wbits, zdict)
+    return Decompress.__new__(Decompress, wbits, zdict, bufsize, max_bufsize)
 
 
 def compressobj(int level=ISAL_DEFAULT_COMPRESSION_I,
@@ -256,7 +344,10 @@ def compressobj(int level=ISAL_DEFAULT_COMPRESSION_I,
                 int wbits=ISAL_DEF_MAX_HIST_BITS,
                 int memLevel=DEF_MEM_LEVEL,
                 int strategy=zlib.Z_DEFAULT_STRATEGY,
-                zdict = None):
+                zdict = None,
+                hufftables = None,
+                Py_ssize_t bufsize = DEF_BUF_SIZE_I,
+                Py_ssize_t max_bufsize = 0):
     """
     Returns a Compress object for compressing data streams.
 
@@ -274,19 +365,133 @@ def compressobj(int level=ISAL_DEFAULT_COMPRESSION_I,
                     no headers and trailers.
     :param memLevel: The amount of memory used for the internal compression
                      state. Higher values use more memory for better speed and
-                     smaller output. Values between 1 and 9 are supported.
+                     smaller output. Values between 1 and 9 are supported and
+                     are mapped onto ISA-L's level buffer sizes (MEM_LEVEL_MIN
+                     up to MEM_LEVEL_EXTRA_LARGE). Lowering memLevel shrinks
+                     the per-stream memory several-fold while barely affecting
+                     the compression ratio; the speed cost is largest at
+                     level 1.
     :zdict:         A predefined compression dictionary. A sequence of bytes
                     that are expected to occur frequently in the to be
                     compressed data. The most common subsequences should come
                     at the end.
+    :param hufftables: Custom Huffman tables created by
+                       igzip_lib.train_hufftables. Only used by level 0
+                       compression.
+    :param bufsize: The initial size of the per-object output buffer. The
+                    buffer is reused between calls, so steady-state
+                    streaming with a fitting bufsize does not allocate.
+    :param max_bufsize: Output buffers grown beyond this size are not
+                        retained between calls. The default of 0 means
+                        the larger of bufsize and 1 MiB.
     """
-    return Compress.__new__(Compress, level, method, wbits, memLevel, strategy, zdict)
+    return Compress.__new__(Compress, level, method, wbits, memLevel, strategy, zdict,
+                            hufftables, bufsize, max_bufsize)
+
+
+# A small cache of level buffers. Services that create a compressobj per
+# payload pay the malloc/free of a buffer of up to hundreds of KiB per
+# object; recycling the buffers removes that cost. All pool accesses are
+# plain C operations that run while holding the GIL, which makes them
+# atomic without a separate lock. At most LEVEL_BUF_CACHE_SIZE buffers
+# (a few MiB at the largest level) are retained.
+DEF LEVEL_BUF_CACHE_SIZE = 8
+cdef unsigned char *_level_buf_cache[LEVEL_BUF_CACHE_SIZE]
+cdef unsigned int _level_buf_cache_sizes[LEVEL_BUF_CACHE_SIZE]
+
+
+cdef unsigned char *level_buf_alloc(unsigned int size):
+    """Return a level buffer of exactly *size* bytes, reusing a pooled
+    buffer when one is available."""
+    cdef int i
+    cdef unsigned char * buf
+    for i in range(LEVEL_BUF_CACHE_SIZE):
+        if (_level_buf_cache[i] is not NULL and
+                _level_buf_cache_sizes[i] == size):
+            buf = _level_buf_cache[i]
+            _level_buf_cache[i] = NULL
+            return buf
+    return <unsigned char *>PyMem_Malloc(size * sizeof(char))
+
+
+cdef void level_buf_free(unsigned char *buf, unsigned int size):
+    """Return a level buffer to the pool, or free it when the pool is
+    full."""
+    cdef int i
+    if buf is NULL:
+        return
+    for i in range(LEVEL_BUF_CACHE_SIZE):
+        if _level_buf_cache[i] is NULL:
+            _level_buf_cache[i] = buf
+            _level_buf_cache_sizes[i] = size
+            return
+    PyMem_Free(buf)
+
+
+cdef void save_scratch_buffer(unsigned char **scratch,
+                              Py_ssize_t *scratch_len,
+                              unsigned char *obuf,
+                              Py_ssize_t obuflen,
+                              Py_ssize_t max_bufsize):
+    """Store a (possibly reallocated) output buffer back on the object
+    for reuse by the next call. Buffers grown beyond max_bufsize are
+    freed so one oversized call does not pin memory forever."""
+    if obuf is NULL:
+        return
+    if obuflen > max_bufsize:
+        PyMem_Free(obuf)
+        scratch[0] = NULL
+        scratch_len[0] = 0
+        return
+    if obuflen <= 0:
+        # The arrange functions returned an error/limit marker, so the
+        # physical size of the buffer is unknown here. It can only be
+        # retained when a previously recorded size vouches for it,
+        # otherwise a zero-length scratch would poison the growth logic
+        # of the next call.
+        if scratch_len[0] > 0:
+            scratch[0] = obuf
+        else:
+            PyMem_Free(obuf)
+        return
+    scratch[0] = obuf
+    scratch_len[0] = obuflen
 
 
 cdef class Compress:
     """Compress object for handling streaming compression."""
     cdef isal_zstream stream
     cdef unsigned char * level_buf
+    cdef object zdict
+    # Keeps custom Huffman tables alive while the stream points at them.
+    cdef object hufftables
+    # Reusable per-object output scratch buffer, so steady-state
+    # streaming does not allocate a fresh output buffer per call.
+    cdef unsigned char * out_scratch
+    cdef Py_ssize_t out_scratch_len
+    cdef Py_ssize_t initial_bufsize
+    cdef Py_ssize_t max_bufsize
+    # Set when the stream was finished with flush(Z_FINISH); a finished
+    # object can not be copied, same as in CPython's zlib.
+    cdef bint finished
+    # Set while a deflate block is being accumulated (compress() calls
+    # without a flush since). In that state the level buffer of levels
+    # 1-3 holds pending symbols and internal pointers into its own
+    # allocation, which cannot be relocated through ISA-L's public API,
+    # so copy() is limited to block boundaries.
+    cdef bint block_in_progress
+    # Since the GIL is released during the isal_deflate call, a per-object
+    # lock protects the stream state when one object is shared between
+    # threads. Same purpose as ENTER_ZLIB in CPython's zlibmodule.c.
+    cdef object lock
+    # Runtime statistics. Plain counter increments, cheap enough to be
+    # always on. Retrieved with stats().
+    cdef unsigned long long stat_bytes_in
+    cdef unsigned long long stat_bytes_out
+    cdef unsigned long long stat_output_growths
+    cdef unsigned long long stat_output_bytes_copied
+    cdef unsigned long long stat_flush_calls
+    cdef long long stat_isal_nanoseconds
 
     def __cinit__(self,
                   int level = ISAL_DEFAULT_COMPRESSION_I,
@@ -294,32 +499,186 @@ cdef class Compress:
                   int wbits = ISAL_DEF_MAX_HIST_BITS,
                   int memLevel = DEF_MEM_LEVEL,
                   int strategy = Z_DEFAULT_STRATEGY,
-                  zdict = None):
+                  zdict = None,
+                  hufftables = None,
+                  Py_ssize_t bufsize = DEF_BUF_SIZE_I,
+                  Py_ssize_t max_bufsize = 0):
+        if bufsize < 1:
+            raise ValueError("bufsize should be at least 1")
+        if max_bufsize == 0:
+            # Default: retain buffers up to 1 MiB, or up to bufsize when
+            # a larger initial buffer was requested explicitly.
+            max_bufsize = max(bufsize, 1024 * 1024)
+        if max_bufsize < bufsize:
+            raise ValueError("max_bufsize should be at least bufsize")
+        self.out_scratch = NULL
+        self.out_scratch_len = 0
+        self.initial_bufsize = bufsize
+        self.max_bufsize = max_bufsize
+        self.finished = False
+        self.block_in_progress = False
         if strategy != Z_DEFAULT_STRATEGY:
             warnings.warn("Only one strategy is supported when using "
                           "isal_zlib. Using the default strategy.")
+        if hufftables is not None:
+            if not isinstance(hufftables, HuffmanTables):
+                raise TypeError("hufftables must be a HuffmanTables "
+                                "object, got: {0}".format(type(hufftables)))
+            if (<HuffmanTables>hufftables).hufftables is NULL:
+                raise ValueError("hufftables was not created by "
+                                 "train_hufftables")
+        self.lock = threading.Lock()
         isal_deflate_init(&self.stream)
+        self.hufftables = hufftables
+        if hufftables is not None:
+            self.stream.hufftables = (<HuffmanTables>hufftables).hufftables
 
         wbits_to_flag_and_hist_bits_deflate(wbits,
                                             &self.stream.hist_bits,
                                             &self.stream.gzip_flag)
 
         cdef Py_ssize_t zdict_length
-        if zdict:
+        if isinstance(zdict, PreparedDict):
+            if (<PreparedDict>zdict).level != level:
+                raise ValueError(
+                    "PreparedDict was prepared for level {0}, not level "
+                    "{1}".format((<PreparedDict>zdict).level, level))
+        elif zdict:
             zdict_length = len(zdict)
             if zdict_length > UINT32_MAX:
                 raise OverflowError("zdict length does not fit in an unsigned int")
             err = isal_deflate_set_dict(&self.stream, zdict, zdict_length)
             if err != COMP_OK:
                 check_isal_deflate_rc(err)
+        self.zdict = zdict
         self.stream.level = level
-        zlib_mem_level_to_isal_bufsize(level, memLevel, &self.stream.level_buf_size)
-        self.level_buf = <unsigned char *>PyMem_Malloc(self.stream.level_buf_size * sizeof(char))
+        if zlib_mem_level_to_isal_bufsize(
+                level, memLevel, &self.stream.level_buf_size) != 0:
+            raise ValueError("Invalid memory level: {0}".format(memLevel))
+        self.level_buf = level_buf_alloc(self.stream.level_buf_size)
         self.stream.level_buf = self.level_buf
+        if isinstance(zdict, PreparedDict):
+            # Applying a processed dictionary copies the precomputed
+            # tables, which needs the level buffer to be in place.
+            err = isal_deflate_reset_dict(
+                &self.stream, (<PreparedDict>zdict).processed)
+            if err != COMP_OK:
+                check_isal_deflate_rc(err)
 
     def __dealloc__(self):
-        if self.level_buf is not NULL:
-            PyMem_Free(self.level_buf)
+        level_buf_free(self.level_buf, self.stream.level_buf_size)
+        if self.out_scratch is not NULL:
+            PyMem_Free(self.out_scratch)
+
+    def reset(self):
+        """Reset the compressor so it can be used for a new stream. The
+        level buffer and all settings are kept, so resetting is much
+        cheaper than creating a new Compress object."""
+        cdef unsigned short hist_bits = self.stream.hist_bits
+        cdef unsigned short gzip_flag = self.stream.gzip_flag
+        cdef unsigned int level = self.stream.level
+        cdef unsigned int level_buf_size = self.stream.level_buf_size
+        cdef Py_ssize_t zdict_length
+        self.lock.acquire()
+        try:
+            self.finished = False
+            self.block_in_progress = False
+            isal_deflate_init(&self.stream)
+            if self.hufftables is not None:
+                self.stream.hufftables = \
+                    (<HuffmanTables>self.hufftables).hufftables
+            self.stream.hist_bits = hist_bits
+            self.stream.gzip_flag = gzip_flag
+            self.stream.level = level
+            self.stream.level_buf = self.level_buf
+            self.stream.level_buf_size = level_buf_size
+            if isinstance(self.zdict, PreparedDict):
+                err = isal_deflate_reset_dict(
+                    &self.stream, (<PreparedDict>self.zdict).processed)
+                if err != COMP_OK:
+                    check_isal_deflate_rc(err)
+            elif self.zdict:
+                zdict_length = len(self.zdict)
+                err = isal_deflate_set_dict(&self.stream, self.zdict,
+                                            zdict_length)
+                if err != COMP_OK:
+                    check_isal_deflate_rc(err)
+        finally:
+            self.lock.release()
+
+    def stats(self):
+        """Return a dict with runtime counters of this object: bytes in
+        and out, the number of output buffer growths and the bytes copied
+        by them, the number of flush calls, and the cumulative time spent
+        inside the ISA-L compression calls in nanoseconds."""
+        return {
+            "bytes_in": self.stat_bytes_in,
+            "bytes_out": self.stat_bytes_out,
+            "output_buffer_growths": self.stat_output_growths,
+            "output_buffer_bytes_copied": self.stat_output_bytes_copied,
+            "flush_calls": self.stat_flush_calls,
+            "isal_nanoseconds": self.stat_isal_nanoseconds,
+        }
+
+    def copy(self):
+        """Return a copy of the compression object, so a shared stream
+        prefix only needs to be compressed once and can be forked per
+        variant.
+
+        For levels 1-3 the object can only be copied at a block boundary:
+        directly after creation, after reset(), or after a Z_SYNC_FLUSH
+        or Z_FULL_FLUSH. In between, the level buffer holds a partially
+        accumulated deflate block with internal pointers into its own
+        allocation, which cannot be relocated through ISA-L's public
+        API."""
+        if self.finished:
+            raise ValueError("Inconsistent stream state")
+        if self.stream.level != 0 and self.block_in_progress:
+            raise ValueError(
+                "Compress objects with level 1-3 can only be copied at a "
+                "block boundary. Flush with Z_SYNC_FLUSH or Z_FULL_FLUSH "
+                "before copying.")
+        cdef Compress clone = Compress.__new__(Compress)
+        cdef unsigned int clone_level_buf_size
+        self.lock.acquire()
+        try:
+            clone_level_buf_size = clone.stream.level_buf_size
+            memcpy(&clone.stream, &self.stream, sizeof(isal_zstream))
+            if clone_level_buf_size != self.stream.level_buf_size:
+                level_buf_free(clone.level_buf, clone_level_buf_size)
+                clone.level_buf = level_buf_alloc(
+                    self.stream.level_buf_size)
+            if clone.level_buf is NULL:
+                raise MemoryError(
+                    "Unsufficient memory for buffer allocation")
+            memcpy(clone.level_buf, self.level_buf,
+                   self.stream.level_buf_size)
+            # The stream's next_in/next_out pointers and the bitbuffer
+            # output window are re-established by isal_deflate at the
+            # start of every call. The level buffer's own internal
+            # pointers are re-established when a new deflate block
+            # starts, which the block-boundary restriction above
+            # guarantees is the next thing that happens on both objects.
+            clone.stream.level_buf = clone.level_buf
+            clone.zdict = self.zdict
+            clone.hufftables = self.hufftables
+            clone.initial_bufsize = self.initial_bufsize
+            clone.max_bufsize = self.max_bufsize
+            clone.stat_bytes_in = self.stat_bytes_in
+            clone.stat_bytes_out = self.stat_bytes_out
+            clone.stat_output_growths = self.stat_output_growths
+            clone.stat_output_bytes_copied = self.stat_output_bytes_copied
+            clone.stat_flush_calls = self.stat_flush_calls
+            clone.stat_isal_nanoseconds = self.stat_isal_nanoseconds
+        finally:
+            self.lock.release()
+        return clone
+
+    def __copy__(self):
+        return self.copy()
+
+    def __deepcopy__(self, memo):
+        return self.copy()
 
     def compress(self, data):
         """
@@ -330,7 +689,7 @@ cdef class Compress:
         """
         # Initialise output buffer
         cdef unsigned char * obuf = NULL
-        cdef Py_ssize_t obuflen = DEF_BUF_SIZE_I
+        cdef Py_ssize_t obuflen = 0
 
         # initialise input
         cdef Py_buffer buffer_data
@@ -338,18 +697,41 @@ cdef class Compress:
         # Cython makes sure error is handled when acquiring buffer fails.
         PyObject_GetBuffer(data, buffer, PyBUF_C_CONTIGUOUS)
         cdef Py_ssize_t ibuflen = buffer.len
-        self.stream.next_in = <unsigned char*>buffer.buf
 
         # initialise helper variables
         cdef int err
+        cdef Py_ssize_t prev_obuflen
+        cdef long long time_start
+        self.lock.acquire()
+        # Take over the scratch buffer from the previous call, if any.
+        obuf = self.out_scratch
+        self.out_scratch = NULL
+        obuflen = (self.out_scratch_len if obuf is not NULL
+                   else self.initial_bufsize)
         try:
+            if obuf is not NULL:
+                # arrange_output_buffer derives the occupied size from
+                # next_out, which is stale from the previous call.
+                self.stream.next_out = obuf
+            self.stream.next_in = <unsigned char*>buffer.buf
+            self.stat_bytes_in += buffer.len
+            if buffer.len > 0:
+                self.block_in_progress = True
             while True:
                 arrange_input_buffer(&self.stream, &ibuflen)
                 while True:
+                    prev_obuflen = obuflen if obuf is not NULL else 0
                     obuflen = arrange_output_buffer(&self.stream, &obuf, obuflen)
                     if obuflen== -1:
                         raise MemoryError("Unsufficient memory for buffer allocation")
-                    err = isal_deflate(&self.stream)
+                    if prev_obuflen != 0 and obuflen > prev_obuflen:
+                        self.stat_output_growths += 1
+                        self.stat_output_bytes_copied += prev_obuflen
+                    with nogil:
+                        time_start = isal_zlib_monotonic_ns()
+                        err = isal_deflate(&self.stream)
+                        self.stat_isal_nanoseconds += (
+                            isal_zlib_monotonic_ns() - time_start)
                     if err != COMP_OK:
                         check_isal_deflate_rc(err)
                     if self.stream.avail_out != 0:
@@ -358,10 +740,13 @@ cdef class Compress:
                     raise AssertionError("Input stream should be empty")
                 if ibuflen == 0:
                     break
+            self.stat_bytes_out += self.stream.next_out - obuf
             return PyBytes_FromStringAndSize(<char*>obuf, self.stream.next_out - obuf)
         finally:
+            save_scratch_buffer(&self.out_scratch, &self.out_scratch_len,
+                                obuf, obuflen, self.max_bufsize)
+            self.lock.release()
             PyBuffer_Release(buffer)
-            PyMem_Free(obuf)
 
     def flush(self, mode=zlib.Z_FINISH):
         """
@@ -377,44 +762,111 @@ cdef class Compress:
         if mode == zlib.Z_NO_FLUSH:
             # Flushing with no_flush does nothing.
             return b""
-        elif mode == zlib.Z_FINISH:
-            self.stream.flush = FULL_FLUSH
-            self.stream.end_of_stream = 1
-        elif mode == zlib.Z_FULL_FLUSH:
-            self.stream.flush = FULL_FLUSH
-        elif mode == zlib.Z_SYNC_FLUSH:
-            self.stream.flush=SYNC_FLUSH
-        else:
+        elif mode not in (zlib.Z_FINISH, zlib.Z_FULL_FLUSH, zlib.Z_SYNC_FLUSH):
             raise IsalError("Unsupported flush mode")
+        if mode == zlib.Z_FINISH:
+            self.finished = True
 
-        cdef Py_ssize_t length = DEF_BUF_SIZE_I
+        cdef Py_ssize_t length = 0
         cdef unsigned char * obuf = NULL
-
+        cdef Py_ssize_t prev_length
+        cdef long long time_start
+
+        self.lock.acquire()
+        obuf = self.out_scratch
+        self.out_scratch = NULL
+        length = (self.out_scratch_len if obuf is not NULL
+                  else self.initial_bufsize)
         try:
+            if obuf is not NULL:
+                self.stream.next_out = obuf
+            self.stat_flush_calls += 1
+            if mode == zlib.Z_FINISH:
+                self.stream.flush = FULL_FLUSH
+                self.stream.end_of_stream = 1
+            elif mode == zlib.Z_FULL_FLUSH:
+                self.stream.flush = FULL_FLUSH
+            elif mode == zlib.Z_SYNC_FLUSH:
+                self.stream.flush=SYNC_FLUSH
             while True:
+                prev_length = length if obuf is not NULL else 0
                 length = arrange_output_buffer(&self.stream, &obuf, length)
                 if length == -1:
                     raise MemoryError("Unsufficient memory for buffer allocation")
-                err = isal_deflate(&self.stream)
+                if prev_length != 0 and length > prev_length:
+                    self.stat_output_growths += 1
+                    self.stat_output_bytes_copied += prev_length
+                with nogil:
+                    time_start = isal_zlib_monotonic_ns()
+                    err = isal_deflate(&self.stream)
+                    self.stat_isal_nanoseconds += (
+                        isal_zlib_monotonic_ns() - time_start)
                 if err != COMP_OK:
                     check_isal_deflate_rc(err)
                 if self.stream.avail_out != 0:
                     break
             if self.stream.avail_in != 0:
                 raise AssertionError("There should be no available input after flushing.")
+            self.block_in_progress = False
+            self.stat_bytes_out += self.stream.next_out - obuf
             return PyBytes_FromStringAndSize(<char*>obuf, self.stream.next_out - obuf)
         finally:
-            PyMem_Free(obuf)
+            save_scratch_buffer(&self.out_scratch, &self.out_scratch_len,
+                                obuf, length, self.max_bufsize)
+            self.lock.release()
 
 cdef class Decompress:
     """Decompress object for handling streaming decompression."""
     cdef public bytes unused_data
-    cdef public bytes unconsumed_tail
+    # The unconsumed tail is kept as a reference into the caller's input
+    # object plus an offset whenever possible, so bounded-output
+    # streaming does not copy the same tail bytes on every call. The
+    # bytes object for the unconsumed_tail attribute is only built when
+    # the attribute is accessed.
+    cdef object tail_object
+    cdef Py_ssize_t tail_offset
+    cdef bytes tail_cache
     cdef public bint eof
     cdef inflate_state stream
     cdef bint method_set
-
-    def __cinit__(self, int wbits=ISAL_DEF_MAX_HIST_BITS, zdict = None):
+    # Set when flush() was called; a flushed object can not be copied,
+    # same as in CPython's zlib.
+    cdef bint flushed
+    # Protects the stream state now the GIL is released during isal_inflate.
+    cdef object lock
+    # Reusable per-object output scratch buffer, so steady-state
+    # streaming does not allocate a fresh output buffer per call.
+    cdef unsigned char * out_scratch
+    cdef Py_ssize_t out_scratch_len
+    cdef Py_ssize_t initial_bufsize
+    cdef Py_ssize_t max_bufsize
+    # Runtime statistics. Plain counter increments, cheap enough to be
+    # always on. Retrieved with stats().
+    cdef unsigned long long stat_bytes_in
+    cdef unsigned long long stat_bytes_out
+    cdef unsigned long long stat_output_growths
+    cdef unsigned long long stat_output_bytes_copied
+    cdef unsigned long long stat_unconsumed_copies
+    cdef unsigned long long stat_unconsumed_bytes_copied
+    cdef unsigned long long stat_flush_calls
+    cdef long long stat_isal_nanoseconds
+
+    def __cinit__(self, int wbits=ISAL_DEF_MAX_HIST_BITS, zdict = None,
+                  Py_ssize_t bufsize = DEF_BUF_SIZE_I,
+                  Py_ssize_t max_bufsize = 0):
+        if bufsize < 1:
+            raise ValueError("bufsize should be at least 1")
+        if max_bufsize == 0:
+            # Default: retain buffers up to 1 MiB, or up to bufsize when
+            # a larger initial buffer was requested explicitly.
+            max_bufsize = max(bufsize, 1024 * 1024)
+        if max_bufsize < bufsize:
+            raise ValueError("max_bufsize should be at least bufsize")
+        self.out_scratch = NULL
+        self.out_scratch_len = 0
+        self.initial_bufsize = bufsize
+        self.max_bufsize = max_bufsize
+        self.lock = threading.Lock()
         isal_inflate_init(&self.stream)
 
         wbits_to_flag_and_hist_bits_inflate(wbits,
@@ -434,8 +886,15 @@ cdef class Decompress:
             if err != COMP_OK:
                 check_isal_deflate_rc(err)
         self.unused_data = b""
-        self.unconsumed_tail = b""
+        self.tail_object = None
+        self.tail_offset = 0
+        self.tail_cache = b""
         self.eof = False
+        self.flushed = False
+
+    def __dealloc__(self):
+        if self.out_scratch is not NULL:
+            PyMem_Free(self.out_scratch)
 
     def _view_bitbuffer(self):
         """Shows the 64-bitbuffer of the internal inflate_state. It contains
@@ -443,7 +902,26 @@ cdef class Decompress:
         of the unconsumed tail."""
         return view_bitbuffer(&self.stream)
 
-    cdef save_unconsumed_input(self, Py_buffer *data):
+    @property
+    def unconsumed_tail(self):
+        if self.tail_cache is None:
+            self.tail_cache = bytes(
+                memoryview(self.tail_object)[self.tail_offset:])
+        return self.tail_cache
+
+    def unconsumed_tail_view(self):
+        """A zero-copy memoryview of the unconsumed tail. Unlike the
+        unconsumed_tail attribute this never builds a new bytes
+        object."""
+        if self.tail_object is None:
+            return memoryview(b"")
+        return memoryview(self.tail_object)[self.tail_offset:]
+
+    def unused_data_view(self):
+        """A zero-copy memoryview of the unused data."""
+        return memoryview(self.unused_data)
+
+    cdef save_unconsumed_input(self, object data_obj, Py_buffer *data):
         cdef Py_ssize_t old_size, new_size, left_size
         cdef bytes new_data
         if self.stream.block_state == ISAL_BLOCK_FINISH:
@@ -460,12 +938,90 @@ cdef class Decompress:
                 # we assume the bitbuffer data is already added.
                 self.unused_data = self._view_bitbuffer()
             self.unused_data += new_data
-            if self.unconsumed_tail:
-                self.unconsumed_tail = b""  # When there is unused_data unconsumed tail should be b""
-        elif self.stream.avail_in > 0 or self.unconsumed_tail:
+            self.stat_unconsumed_copies += 1
+            self.stat_unconsumed_bytes_copied += len(new_data)
+            if self.tail_object is not None or self.tail_cache != b"":
+                # When there is unused_data unconsumed tail should be b""
+                self.tail_object = None
+                self.tail_offset = 0
+                self.tail_cache = b""
+        elif self.stream.avail_in > 0 or self.tail_object is not None:
             left_size = <unsigned char*>data.buf + data.len - self.stream.next_in
-            new_data = PyBytes_FromStringAndSize(<char *>self.stream.next_in, left_size)
-            self.unconsumed_tail = new_data
+            if left_size == 0:
+                self.tail_object = None
+                self.tail_offset = 0
+                self.tail_cache = b""
+            elif PyBytes_Check(data_obj) and left_size * 4 >= data.len:
+                # The input is immutable and the tail makes up a
+                # substantial part of it: keep a reference and an offset
+                # instead of copying. The threshold avoids pinning a large
+                # input object for a tiny tail.
+                self.tail_object = data_obj
+                self.tail_offset = data.len - left_size
+                self.tail_cache = None
+            else:
+                new_data = PyBytes_FromStringAndSize(<char *>self.stream.next_in, left_size)
+                self.tail_object = new_data
+                self.tail_offset = 0
+                self.tail_cache = new_data
+                self.stat_unconsumed_copies += 1
+                self.stat_unconsumed_bytes_copied += left_size
+
+    def stats(self):
+        """Return a dict with runtime counters of this object: bytes in
+        and out, the number of output buffer growths and the bytes copied
+        by them, the unconsumed input copies made by bounded decompression,
+        the number of flush calls, and the cumulative time spent inside
+        the ISA-L decompression calls in nanoseconds."""
+        return {
+            "bytes_in": self.stat_bytes_in,
+            "bytes_out": self.stat_bytes_out,
+            "output_buffer_growths": self.stat_output_growths,
+            "output_buffer_bytes_copied": self.stat_output_bytes_copied,
+            "unconsumed_copies": self.stat_unconsumed_copies,
+            "unconsumed_bytes_copied": self.stat_unconsumed_bytes_copied,
+            "flush_calls": self.stat_flush_calls,
+            "isal_nanoseconds": self.stat_isal_nanoseconds,
+        }
+
+    def copy(self):
+        """Return a copy of the decompression object, so a shared stream
+        prefix only needs to be decompressed once."""
+        if self.flushed:
+            raise ValueError("Inconsistent stream state")
+        cdef Decompress clone = Decompress.__new__(Decompress)
+        self.lock.acquire()
+        try:
+            # The inflate state is fully self-contained apart from the
+            # next_in/next_out pointers, which are set at the start of
+            # every call.
+            memcpy(&clone.stream, &self.stream, sizeof(inflate_state))
+            clone.method_set = self.method_set
+            clone.eof = self.eof
+            clone.unused_data = self.unused_data
+            clone.tail_object = self.tail_object
+            clone.tail_offset = self.tail_offset
+            clone.tail_cache = self.tail_cache
+            clone.initial_bufsize = self.initial_bufsize
+            clone.max_bufsize = self.max_bufsize
+            clone.stat_bytes_in = self.stat_bytes_in
+            clone.stat_bytes_out = self.stat_bytes_out
+            clone.stat_output_growths = self.stat_output_growths
+            clone.stat_output_bytes_copied = self.stat_output_bytes_copied
+            clone.stat_unconsumed_copies = self.stat_unconsumed_copies
+            clone.stat_unconsumed_bytes_copied = \
+                self.stat_unconsumed_bytes_copied
+            clone.stat_flush_calls = self.stat_flush_calls
+            clone.stat_isal_nanoseconds = self.stat_isal_nanoseconds
+        finally:
+            self.lock.release()
+        return clone
+
+    def __copy__(self):
+        return self.copy()
+
+    def __deepcopy__(self, memo):
+        return self.copy()
 
     def decompress(self, data, Py_ssize_t max_length = 0):
         """
@@ -485,32 +1041,48 @@ cdef class Decompress:
         else:
             hard_limit = max_length
 
-        if not self.method_set:
-            # Try to detect method from the first two bytes of the data.
-            self.stream.crc_flag = ISAL_GZIP if data_is_gzip(data) else ISAL_ZLIB
-            self.method_set = 1
-
         # initialise input
         cdef Py_buffer buffer_data
         cdef Py_buffer* buffer = &buffer_data
         # Cython makes sure error is handled when acquiring buffer fails.
         PyObject_GetBuffer(data, buffer, PyBUF_C_CONTIGUOUS)
         cdef Py_ssize_t ibuflen = buffer.len
-        self.stream.next_in = <unsigned char*>buffer.buf
 
         cdef int err
         cdef bint max_length_reached = False
-        
+        cdef Py_ssize_t prev_obuflen
+        cdef long long time_start
+
         # Initialise output buffer
         cdef unsigned char *obuf = NULL
-        cdef Py_ssize_t obuflen = DEF_BUF_SIZE_I
+        cdef Py_ssize_t obuflen
+
+        self.lock.acquire()
+        # Take over the scratch buffer from the previous call, if any.
+        obuf = self.out_scratch
+        self.out_scratch = NULL
+        obuflen = (self.out_scratch_len if obuf is not NULL
+                   else self.initial_bufsize)
         if obuflen > hard_limit:
+            # The physical buffer may be larger; the smaller logical
+            # length makes arrange_output_buffer_with_maximum enforce
+            # max_length.
             obuflen = hard_limit
-
         try:
+            if obuf is not NULL:
+                # arrange_output_buffer derives the occupied size from
+                # next_out, which is stale from the previous call.
+                self.stream.next_out = obuf
+            if not self.method_set:
+                # Try to detect method from the first two bytes of the data.
+                self.stream.crc_flag = ISAL_GZIP if data_is_gzip(data) else ISAL_ZLIB
+                self.method_set = 1
+            self.stream.next_in = <unsigned char*>buffer.buf
+            self.stat_bytes_in += buffer.len
             while True:
                 arrange_input_buffer(&self.stream, &ibuflen)
                 while True:
+                    prev_obuflen = obuflen if obuf is not NULL else 0
                     obuflen = arrange_output_buffer_with_maximum(
                               &self.stream, &obuf, obuflen, hard_limit)
                     if obuflen == -1:
@@ -518,18 +1090,28 @@ cdef class Decompress:
                     elif obuflen == -2:
                         max_length_reached = True
                         break
-                    err = isal_inflate(&self.stream)
+                    if prev_obuflen != 0 and obuflen > prev_obuflen:
+                        self.stat_output_growths += 1
+                        self.stat_output_bytes_copied += prev_obuflen
+                    with nogil:
+                        time_start = isal_zlib_monotonic_ns()
+                        err = isal_inflate(&self.stream)
+                        self.stat_isal_nanoseconds += (
+                            isal_zlib_monotonic_ns() - time_start)
                     if err != ISAL_DECOMP_OK:
                         check_isal_inflate_rc(err)
                     if self.stream.block_state == ISAL_BLOCK_FINISH or self.stream.avail_out != 0:
                         break
                 if self.stream.block_state == ISAL_BLOCK_FINISH or ibuflen ==0 or max_length_reached:
                     break
-            self.save_unconsumed_input(buffer)
+            self.save_unconsumed_input(data, buffer)
+            self.stat_bytes_out += self.stream.next_out - obuf
             return PyBytes_FromStringAndSize(<char*>obuf, self.stream.next_out - obuf)
         finally:
+            save_scratch_buffer(&self.out_scratch, &self.out_scratch_len,
+                                obuf, obuflen, self.max_bufsize)
+            self.lock.release()
             PyBuffer_Release(buffer)
-            PyMem_Free(obuf)
 
     def flush(self, Py_ssize_t length = DEF_BUF_SIZE):
         """
@@ -540,36 +1122,52 @@ cdef class Decompress:
         """
         if length <= 0:
             raise ValueError("Length must be greater than 0")
+        self.flushed = True
 
         cdef Py_buffer buffer_data
         cdef Py_buffer* buffer = &buffer_data
         # Cython makes sure error is handled when acquiring buffer fails.
-        PyObject_GetBuffer(self.unconsumed_tail, buffer, PyBUF_C_CONTIGUOUS)
+        cdef bytes tail = self.unconsumed_tail
+        PyObject_GetBuffer(tail, buffer, PyBUF_C_CONTIGUOUS)
         cdef Py_ssize_t ibuflen = buffer.len
-        self.stream.next_in = <unsigned char*>buffer.buf
 
         cdef unsigned int obuflen = length
         cdef unsigned char * obuf = NULL
+        cdef Py_ssize_t prev_obuflen
+        cdef long long time_start
 
         cdef int err
 
+        self.lock.acquire()
         try:
+            self.stat_flush_calls += 1
+            self.stream.next_in = <unsigned char*>buffer.buf
             while True:
                 arrange_input_buffer(&self.stream, &ibuflen)
                 while True:
+                    prev_obuflen = obuflen if obuf is not NULL else 0
                     obuflen = arrange_output_buffer(&self.stream, &obuf, obuflen)
                     if obuflen == -1:
                         raise MemoryError("Unsufficient memory for buffer allocation")
-                    err = isal_inflate(&self.stream)
+                    if prev_obuflen != 0 and obuflen > prev_obuflen:
+                        self.stat_output_growths += 1
+                        self.stat_output_bytes_copied += prev_obuflen
+                    with nogil:
+                        time_start = isal_zlib_monotonic_ns()
+                        err = isal_inflate(&self.stream)
+                        self.stat_isal_nanoseconds += (
+                            isal_zlib_monotonic_ns() - time_start)
                     if err != ISAL_DECOMP_OK:
                         check_isal_inflate_rc(err)
                     if self.stream.avail_out != 0 or self.stream.block_state == ISAL_BLOCK_FINISH:
                         break
                 if self.stream.block_state == ISAL_BLOCK_FINISH or ibuflen == 0:
                     break
-            self.save_unconsumed_input(buffer)
+            self.save_unconsumed_input(tail, buffer)
+            self.stat_bytes_out += self.stream.next_out - obuf
             return PyBytes_FromStringAndSize(<char*>obuf, self.stream.next_out - obuf)
         finally:
+            self.lock.release()
             PyBuffer_Release(buffer)
             PyMem_Free(obuf)
 
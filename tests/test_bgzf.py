@@ -0,0 +1,125 @@
+# Copyright (c) 2020 Leiden University Medical Center
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Tests for the bgzf module."""
+
+import gzip
+import io
+import itertools
+
+from isal import bgzf
+
+import pytest
+
+from .test_compat import DATA as RAW_DATA
+
+DATA = RAW_DATA[:256 * 1024]
+
+
+def write_bgzf(data, threads=1, block_size=bgzf.MAX_BLOCK_DATA_SIZE,
+               compresslevel=2):
+    fileobj = io.BytesIO()
+    with bgzf.BGZFWriter(fileobj, compresslevel, threads=threads,
+                         block_size=block_size) as writer:
+        writer.write(data)
+    return fileobj.getvalue()
+
+
+@pytest.mark.parametrize(["threads", "level"],
+                         itertools.product([1, 2, 4], [0, 1, 2, 3]))
+def test_roundtrip(threads, level):
+    compressed = write_bgzf(DATA, threads=threads, compresslevel=level)
+    with bgzf.open(io.BytesIO(compressed), threads=threads) as reader:
+        assert reader.read() == DATA
+
+
+def test_output_is_valid_gzip():
+    compressed = write_bgzf(DATA)
+    assert gzip.decompress(compressed) == DATA
+
+
+def test_eof_marker():
+    compressed = write_bgzf(DATA)
+    assert compressed.endswith(bgzf.BGZF_EOF)
+
+
+def test_empty_file():
+    compressed = write_bgzf(b"")
+    assert compressed == bgzf.BGZF_EOF
+    with bgzf.open(io.BytesIO(compressed)) as reader:
+        assert reader.read() == b""
+
+
+def test_block_sizes():
+    compressed = write_bgzf(DATA, block_size=4096)
+    with bgzf.open(io.BytesIO(compressed), threads=2) as reader:
+        assert reader.read() == DATA
+
+
+def test_virtual_offset_seek():
+    data = b"".join(b"record %08d\n" % i for i in range(10000))
+    compressed = write_bgzf(data, block_size=4096)
+    reader = bgzf.BGZFReader(io.BytesIO(compressed), threads=2)
+    offsets_and_records = []
+    for _ in range(20):
+        offsets_and_records.append((reader.tell(), reader.read(13)))
+    for virtual_offset, record in reversed(offsets_and_records):
+        reader.seek(virtual_offset)
+        assert reader.read(13) == record
+    reader.close()
+
+
+def test_virtual_offset_helpers():
+    virtual_offset = bgzf.make_virtual_offset(12345, 678)
+    assert bgzf.split_virtual_offset(virtual_offset) == (12345, 678)
+
+
+def test_not_bgzf_file():
+    compressed = gzip.compress(DATA)  # No BC extra field.
+    with pytest.raises(bgzf.BGZFError) as error:
+        bgzf.open(io.BytesIO(compressed)).read()
+    error.match("extra field|BC subfield")
+
+
+def test_truncated_block():
+    compressed = write_bgzf(DATA)
+    with pytest.raises(bgzf.BGZFError) as error:
+        with bgzf.open(io.BytesIO(compressed[:len(compressed) // 2])) as f:
+            f.read()
+    error.match("Truncated")
+
+
+def test_flush_creates_partial_block():
+    fileobj = io.BytesIO()
+    with bgzf.BGZFWriter(fileobj, threads=2) as writer:
+        writer.write(DATA[:100])
+        writer.flush()
+        writer.write(DATA[100:200])
+    assert gzip.decompress(fileobj.getvalue()) == DATA[:200]
+
+
+def test_invalid_block_size():
+    with pytest.raises(ValueError):
+        bgzf.BGZFWriter(io.BytesIO(), block_size=100000)
+
+
+def test_invalid_level():
+    with pytest.raises(ValueError):
+        bgzf.BGZFWriter(io.BytesIO(), compresslevel=9)
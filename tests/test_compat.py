@@ -58,6 +58,34 @@ def test_adler32(data_size, value):
     assert zlib.adler32(data, value) == isal_zlib.adler32(data, value)
 
 
+@pytest.mark.parametrize("split", [0, 1, 333, 2**14, 2**16 + 3])
+def test_crc32_combine(split):
+    data = DATA[:2**17]
+    part1 = data[:split]
+    part2 = data[split:]
+    combined = isal_zlib.crc32_combine(isal_zlib.crc32(part1),
+                                       isal_zlib.crc32(part2),
+                                       len(part2))
+    assert combined == zlib.crc32(data)
+
+
+@pytest.mark.parametrize("split", [0, 1, 333, 2**14, 2**16 + 3])
+def test_adler32_combine(split):
+    data = DATA[:2**17]
+    part1 = data[:split]
+    part2 = data[split:]
+    combined = isal_zlib.adler32_combine(isal_zlib.adler32(part1),
+                                         isal_zlib.adler32(part2),
+                                         len(part2))
+    assert combined == zlib.adler32(data)
+
+
+@pytest.mark.parametrize("function", ["crc32_combine", "adler32_combine"])
+def test_combine_negative_length(function):
+    with pytest.raises(ValueError):
+        getattr(isal_zlib, function)(0, 0, -1)
+
+
 @pytest.mark.parametrize(["data_size", "level"],
                          itertools.product(DATA_SIZES, range(4)))
 def test_compress(data_size, level):
@@ -174,3 +202,149 @@ def test_unused_data(unused_size, wbits):
     result = decompressor.decompress(compressed + unused_data)
     assert result == data
     assert decompressor.unused_data == unused_data
+
+
+def test_compressobj_reset():
+    data = DATA[:64 * 1024]
+    compressobj = isal_zlib.compressobj(wbits=-15)
+    first = compressobj.compress(data) + compressobj.flush()
+    compressobj.reset()
+    second = compressobj.compress(data) + compressobj.flush()
+    assert first == second
+    assert zlib.decompress(second, wbits=-15) == data
+
+
+def test_compressobj_reset_with_zdict():
+    data = DATA[:64 * 1024]
+    zdict = data[:1024]
+    compressobj = isal_zlib.compressobj(wbits=-15, zdict=zdict)
+    first = compressobj.compress(data) + compressobj.flush()
+    compressobj.reset()
+    second = compressobj.compress(data) + compressobj.flush()
+    assert first == second
+    decompressobj = zlib.decompressobj(wbits=-15, zdict=zdict)
+    assert decompressobj.decompress(second) == data
+
+
+def test_compress_stats():
+    data = DATA[:128 * 1024]
+    compressobj = isal_zlib.compressobj()
+    compressed = compressobj.compress(data) + compressobj.flush()
+    stats = compressobj.stats()
+    assert stats["bytes_in"] == len(data)
+    assert stats["bytes_out"] == len(compressed)
+    assert stats["flush_calls"] == 1
+    assert stats["isal_nanoseconds"] > 0
+
+
+def test_decompress_stats():
+    data = DATA[:128 * 1024]
+    compressed = isal_zlib.compress(data)
+    decompressobj = isal_zlib.decompressobj()
+    result = decompressobj.decompress(compressed)
+    stats = decompressobj.stats()
+    assert stats["bytes_in"] == len(compressed)
+    assert stats["bytes_out"] == len(result)
+    # The output started at the default buffer size and was grown by
+    # doubling, so growths and copied bytes must be non-zero.
+    assert stats["output_buffer_growths"] > 0
+    assert stats["output_buffer_bytes_copied"] > 0
+
+
+def test_decompress_stats_bounded():
+    data = DATA[:128 * 1024]
+    compressed = isal_zlib.compress(data)
+    decompressobj = isal_zlib.decompressobj()
+    decompressobj.decompress(compressed, 1000)
+    stats = decompressobj.stats()
+    assert stats["unconsumed_copies"] > 0
+    assert stats["unconsumed_bytes_copied"] > 0
+
+
+def test_unconsumed_tail_views():
+    data = DATA[:128 * 1024]
+    compressed = isal_zlib.compress(data)
+    decompressobj = isal_zlib.decompressobj()
+    chunks = [decompressobj.decompress(compressed, 4096)]
+    while decompressobj.unconsumed_tail:
+        # The attribute and the zero-copy view must stay in sync.
+        assert (bytes(decompressobj.unconsumed_tail_view()) ==
+                decompressobj.unconsumed_tail)
+        chunks.append(
+            decompressobj.decompress(decompressobj.unconsumed_tail, 4096))
+    assert b"".join(chunks) == data
+    assert decompressobj.unconsumed_tail_view() == b""
+
+
+def test_unused_data_view():
+    compressed = isal_zlib.compress(DATA[:1024]) + b"extra data"
+    decompressobj = isal_zlib.decompressobj()
+    decompressobj.decompress(compressed)
+    assert bytes(decompressobj.unused_data_view()) == b"extra data"
+    assert decompressobj.unused_data == b"extra data"
+
+
+def test_compressobj_buffer_reuse():
+    data = DATA[:256 * 1024]
+    compressobj = isal_zlib.compressobj(wbits=-15, bufsize=64 * 1024)
+    chunks = [compressobj.compress(data[i:i + 64 * 1024])
+              for i in range(0, len(data), 64 * 1024)]
+    chunks.append(compressobj.flush())
+    assert zlib.decompress(b"".join(chunks), wbits=-15) == data
+
+
+def test_decompressobj_buffer_reuse():
+    data = DATA[:256 * 1024]
+    compressed = isal_zlib.compress(data)
+    decompressobj = isal_zlib.decompressobj(bufsize=256 * 1024)
+    result = decompressobj.decompress(compressed)
+    result += decompressobj.flush()
+    assert result == data
+    # The large output was produced in one buffer, so no growths.
+    assert decompressobj.stats()["output_buffer_growths"] == 0
+
+
+def test_decompressobj_bounded_with_buffer_reuse():
+    data = DATA[:256 * 1024]
+    compressed = isal_zlib.compress(data)
+    decompressobj = isal_zlib.decompressobj(bufsize=4096)
+    chunks = [decompressobj.decompress(compressed, 4096)]
+    while decompressobj.unconsumed_tail:
+        chunks.append(decompressobj.decompress(
+            decompressobj.unconsumed_tail, 4096))
+    assert b"".join(chunks) == data
+
+
+@pytest.mark.parametrize("factory", ["compressobj", "decompressobj"])
+def test_invalid_bufsize(factory):
+    with pytest.raises(ValueError):
+        getattr(isal_zlib, factory)(bufsize=0)
+
+
+def test_compress_copy_mid_block_refused():
+    compressobj = isal_zlib.compressobj()
+    compressobj.compress(DATA[:1000])
+    with pytest.raises(ValueError) as error:
+        compressobj.copy()
+    error.match("block boundary")
+
+
+def test_compress_copy_at_flush_boundary():
+    data = DATA[:64 * 1024]
+    suffix_a = DATA[64 * 1024:128 * 1024]
+    suffix_b = DATA[128 * 1024:192 * 1024]
+    shared = isal_zlib.compressobj(wbits=-15)
+    prefix = shared.compress(data) + shared.flush(isal_zlib.Z_SYNC_FLUSH)
+    fork = shared.copy()
+    stream_a = (prefix + shared.compress(suffix_a) + shared.flush())
+    stream_b = (prefix + fork.compress(suffix_b) + fork.flush())
+    assert zlib.decompress(stream_a, wbits=-15) == data + suffix_a
+    assert zlib.decompress(stream_b, wbits=-15) == data + suffix_b
+
+
+def test_compress_copy_fresh_object():
+    compressobj = isal_zlib.compressobj(wbits=-15)
+    clone = compressobj.copy()
+    data = DATA[:1000]
+    assert (compressobj.compress(data) + compressobj.flush() ==
+            clone.compress(data) + clone.flush())
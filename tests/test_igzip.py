@@ -296,3 +296,256 @@ def test_concatenated_gzip():
     with igzip.open(concat, "rb") as igzip_h:
         result = igzip_h.read()
     assert data == result
+
+
+def test_iter_lines():
+    test_gz = Path(__file__).parent / "data" / "test.fastq.gz"
+    with gzip.open(test_gz, "rb") as gzip_h:
+        expected = gzip_h.read().split(b"\n")
+    if expected[-1] == b"":
+        expected.pop()
+    with igzip.open(test_gz, "rb") as igzip_h:
+        assert list(igzip_h.iter_lines()) == expected
+
+
+def test_iter_lines_small_chunks():
+    data = b"\n".join([b"lineno %d" % i for i in range(1000)])
+    fileobj = io.BytesIO(gzip.compress(data))
+    with igzip.open(fileobj, "rb") as igzip_h:
+        # A chunk size smaller than the line length forces lines to span
+        # chunk borders.
+        assert list(igzip_h.iter_lines(chunk_size=7)) == data.split(b"\n")
+
+
+def test_iter_lines_no_trailing_newline():
+    fileobj = io.BytesIO(gzip.compress(b"one\ntwo\nthree"))
+    with igzip.open(fileobj, "rb") as igzip_h:
+        assert list(igzip_h.iter_lines()) == [b"one", b"two", b"three"]
+
+
+def test_iter_lines_empty():
+    fileobj = io.BytesIO(gzip.compress(b""))
+    with igzip.open(fileobj, "rb") as igzip_h:
+        assert list(igzip_h.iter_lines()) == []
+
+
+def test_iter_lines_on_write_file(tmp_path):
+    with igzip.open(tmp_path / "test.gz", "wb") as igzip_h:
+        with pytest.raises(OSError):
+            igzip_h.iter_lines()
+
+
+def test_open_mmap(tmp_path):
+    test_file = tmp_path / "test.gz"
+    test_file.write_bytes(gzip.compress(DATA))
+    with igzip.open(test_file, "rb", use_mmap=True) as mmap_h:
+        assert mmap_h.read() == DATA
+
+
+def test_open_mmap_multi_member(tmp_path):
+    test_file = tmp_path / "test.gz"
+    test_file.write_bytes(gzip.compress(DATA) + gzip.compress(DATA))
+    with igzip.open(test_file, "rb", use_mmap=True) as mmap_h:
+        assert mmap_h.read() == DATA + DATA
+
+
+def test_open_mmap_fileobj(tmp_path):
+    test_file = tmp_path / "test.gz"
+    test_file.write_bytes(gzip.compress(DATA))
+    with io.open(test_file, "rb") as raw:
+        with igzip.open(raw, "rb", use_mmap=True) as mmap_h:
+            assert mmap_h.read() == DATA
+
+
+def test_open_mmap_empty_file(tmp_path):
+    test_file = tmp_path / "test.gz"
+    test_file.write_bytes(b"")
+    with igzip.open(test_file, "rb", use_mmap=True) as mmap_h:
+        assert mmap_h.read() == b""
+
+
+def test_open_mmap_seek(tmp_path):
+    test_file = tmp_path / "test.gz"
+    test_file.write_bytes(gzip.compress(DATA))
+    with igzip.open(test_file, "rb", use_mmap=True) as mmap_h:
+        mmap_h.read(10)
+        mmap_h.seek(0)
+        assert mmap_h.read(10) == DATA[:10]
+
+
+def test_open_mmap_text_mode(tmp_path):
+    test_file = tmp_path / "test.gz"
+    test_file.write_bytes(gzip.compress(b"mmap hello"))
+    with igzip.open(test_file, "rt", use_mmap=True) as mmap_h:
+        assert mmap_h.read() == "mmap hello"
+
+
+def test_open_mmap_write_mode_fails(tmp_path):
+    with pytest.raises(ValueError):
+        igzip.open(tmp_path / "test.gz", "wb", use_mmap=True)
+
+
+def test_compress_stdin_stdout_threaded(capsysbinary):
+    mock_stdin = io.BytesIO(DATA)
+    sys.stdin = io.TextIOWrapper(mock_stdin)
+    sys.argv = ["", "-T", "4"]
+    igzip.main()
+    out, err = capsysbinary.readouterr()
+    assert err == b''
+    assert gzip.decompress(out) == DATA
+
+
+def test_decompress_stdin_stdout_threaded(capsysbinary):
+    mock_stdin = io.BytesIO(gzip.compress(DATA))
+    sys.stdin = io.TextIOWrapper(mock_stdin)
+    sys.argv = ["", "-d", "-T", "4"]
+    igzip.main()
+    out, err = capsysbinary.readouterr()
+    assert err == b''
+    assert out == DATA
+
+
+def test_compress_infile_outfile_threaded(tmp_path, capsysbinary):
+    test_file = tmp_path / "test"
+    test_file.write_bytes(DATA)
+    sys.argv = ['', '-T', '2', str(test_file)]
+    igzip.main()
+    out_file = test_file.with_suffix(".gz")
+    out, err = capsysbinary.readouterr()
+    assert err == b''
+    assert out == b''
+    assert gzip.decompress(out_file.read_bytes()) == DATA
+
+
+def test_threads_zero_errors():
+    sys.argv = ['', '-T', '0']
+    with pytest.raises(SystemExit):
+        igzip.main()
+
+
+def test_open_readahead(tmp_path):
+    test_file = tmp_path / "test.gz"
+    test_file.write_bytes(gzip.compress(DATA))
+    with igzip.open(test_file, "rb", readahead=True) as igzip_h:
+        assert igzip_h.read() == DATA
+
+
+def test_open_readahead_fileobj():
+    fileobj = io.BytesIO(gzip.compress(DATA))
+    with igzip.open(fileobj, "rb", readahead=True) as igzip_h:
+        assert igzip_h.read() == DATA
+
+
+def test_open_readahead_multi_member(tmp_path):
+    test_file = tmp_path / "test.gz"
+    test_file.write_bytes(gzip.compress(DATA) + gzip.compress(DATA))
+    with igzip.open(test_file, "rb", readahead=True) as igzip_h:
+        assert igzip_h.read() == DATA + DATA
+
+
+def test_open_readahead_seek(tmp_path):
+    test_file = tmp_path / "test.gz"
+    test_file.write_bytes(gzip.compress(DATA))
+    with igzip.open(test_file, "rb", readahead=True) as igzip_h:
+        igzip_h.read(100)
+        igzip_h.seek(10)
+        assert igzip_h.read(10) == DATA[10:20]
+
+
+def test_open_readahead_small_reads(tmp_path):
+    test_file = tmp_path / "test.gz"
+    test_file.write_bytes(gzip.compress(DATA))
+    chunks = []
+    with igzip.open(test_file, "rb", readahead=True) as igzip_h:
+        while True:
+            chunk = igzip_h.read(333)
+            if not chunk:
+                break
+            chunks.append(chunk)
+    assert b"".join(chunks) == DATA
+
+
+def test_open_readahead_write_mode_fails(tmp_path):
+    with pytest.raises(ValueError):
+        igzip.open(tmp_path / "test.gz", "wb", readahead=True)
+
+
+def test_open_readahead_with_mmap_fails(tmp_path):
+    with pytest.raises(ValueError):
+        igzip.open(tmp_path / "test.gz", "rb", readahead=True,
+                   use_mmap=True)
+
+
+def test_readinto():
+    fileobj = io.BytesIO(gzip.compress(DATA))
+    out = bytearray(len(DATA))
+    with igzip.open(fileobj, "rb") as igzip_h:
+        # A view over the whole buffer makes BufferedReader use the
+        # direct raw readinto path.
+        assert igzip_h.readinto(memoryview(out)) == len(DATA)
+    assert out == DATA
+
+
+def test_readinto_multi_member():
+    fileobj = io.BytesIO(gzip.compress(DATA) + gzip.compress(DATA))
+    out = bytearray(2 * len(DATA))
+    with igzip.open(fileobj, "rb") as igzip_h:
+        total = 0
+        while total < len(out):
+            written = igzip_h.readinto(memoryview(out)[total:])
+            if written == 0:
+                break
+            total += written
+    assert total == 2 * len(DATA)
+    assert out == DATA + DATA
+
+
+def test_readinto_small_buffers():
+    fileobj = io.BytesIO(gzip.compress(DATA))
+    out = bytearray(333)
+    result = bytearray()
+    with igzip.open(fileobj, "rb") as igzip_h:
+        while True:
+            written = igzip_h.readinto(out)
+            if written == 0:
+                break
+            result.extend(out[:written])
+    assert result == DATA
+
+
+def test_readinto1():
+    fileobj = io.BytesIO(gzip.compress(DATA))
+    out = bytearray(len(DATA))
+    with igzip.open(fileobj, "rb") as igzip_h:
+        written = igzip_h.readinto1(memoryview(out))
+    assert out[:written] == DATA[:written]
+    assert written > 0
+
+
+def test_readinto_on_write_file(tmp_path):
+    with igzip.open(tmp_path / "test.gz", "wb") as igzip_h:
+        with pytest.raises(OSError):
+            igzip_h.readinto(bytearray(10))
+
+
+def test_open_mmap_padded_multi_member(tmp_path):
+    # The zero padding spans multiple read chunks, so the padding skip
+    # does one-byte reads from the mapping and prepends the first byte
+    # of the next member. This is a regression test for memoryview
+    # slices ending up in the _PaddedFile buffer.
+    test_file = tmp_path / "test.gz"
+    test_file.write_bytes(gzip.compress(DATA) + b"\x00" * (256 * 1024) +
+                          gzip.compress(DATA))
+    with igzip.open(test_file, "rb", use_mmap=True) as mmap_h:
+        assert mmap_h.read() == DATA + DATA
+
+
+def test_decompress_many_small_members_with_large_last_member():
+    # The ISIZE hint from the stream's trailer belongs to the last
+    # member; it must not cause a large allocation for every small
+    # member before it.
+    members = [gzip.compress(b"tiny record %d\n" % i) for i in range(50)]
+    members.append(gzip.compress(DATA))
+    data = b"".join(members)
+    expected = b"".join(b"tiny record %d\n" % i for i in range(50)) + DATA
+    assert igzip.decompress(data) == expected
@@ -0,0 +1,116 @@
+# Copyright (c) 2020 Leiden University Medical Center
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Tests for the igzip_async module."""
+
+import asyncio
+import gzip
+import io
+
+from isal import igzip_async
+
+import pytest
+
+from .test_compat import DATA as RAW_DATA
+
+DATA = RAW_DATA[:256 * 1024]
+
+
+def test_read_all():
+    async def read_all():
+        async with igzip_async.open(io.BytesIO(gzip.compress(DATA))) as f:
+            return await f.read()
+    assert asyncio.run(read_all()) == DATA
+
+
+def test_read_sized():
+    async def read_sized():
+        parts = []
+        async with igzip_async.open(io.BytesIO(gzip.compress(DATA)),
+                                    chunk_size=1024) as f:
+            while True:
+                part = await f.read(333)
+                if not part:
+                    break
+                parts.append(part)
+        return parts
+    parts = asyncio.run(read_sized())
+    assert all(len(part) <= 333 for part in parts)
+    assert b"".join(parts) == DATA
+
+
+def test_readline():
+    data = b"first line\nsecond line\nlast line"
+
+    async def read_lines():
+        lines = []
+        async with igzip_async.open(io.BytesIO(gzip.compress(data))) as f:
+            while True:
+                line = await f.readline()
+                if not line:
+                    break
+                lines.append(line)
+        return lines
+    assert asyncio.run(read_lines()) == [b"first line\n", b"second line\n",
+                                         b"last line"]
+
+
+def test_aiter():
+    data = b"\n".join(b"line %d" % i for i in range(100)) + b"\n"
+
+    async def iterate():
+        lines = []
+        async with igzip_async.open(io.BytesIO(gzip.compress(data))) as f:
+            async for line in f:
+                lines.append(line)
+        return lines
+    assert asyncio.run(iterate()) == data.splitlines(keepends=True)
+
+
+def test_error_propagates():
+    async def read_corrupt():
+        corrupt = io.BytesIO(b"This is not a gzip stream at all.")
+        async with igzip_async.open(corrupt) as f:
+            await f.read()
+    with pytest.raises(OSError):
+        asyncio.run(read_corrupt())
+
+
+def test_close_early():
+    async def close_early():
+        fileobj = io.BytesIO(gzip.compress(DATA))
+        f = igzip_async.open(fileobj, chunk_size=1024, queue_size=2)
+        await f.read(10)
+        await f.aclose()
+    asyncio.run(close_early())
+
+
+def test_read_after_close():
+    async def read_after_close():
+        f = igzip_async.open(io.BytesIO(gzip.compress(DATA)))
+        await f.aclose()
+        await f.read()
+    with pytest.raises(ValueError):
+        asyncio.run(read_after_close())
+
+
+def test_open_write_mode_fails():
+    with pytest.raises(ValueError):
+        igzip_async.open(io.BytesIO(), "wb")
@@ -0,0 +1,121 @@
+# Copyright (c) 2020 Leiden University Medical Center
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Tests for the igzip_index module."""
+
+import gzip
+import io
+
+from isal import igzip_index
+
+import pytest
+
+from .test_compat import DATA as RAW_DATA
+
+DATA = RAW_DATA[:256 * 1024]
+MEMBER_SIZE = 16 * 1024
+MULTI_MEMBER = b"".join(gzip.compress(DATA[i:i + MEMBER_SIZE])
+                        for i in range(0, len(DATA), MEMBER_SIZE))
+
+
+def test_build_index():
+    index = igzip_index.GzipIndex.build(io.BytesIO(MULTI_MEMBER),
+                                        span=32 * 1024)
+    assert index.uncompressed_size == len(DATA)
+    assert index.compressed_size == len(MULTI_MEMBER)
+    assert index.checkpoints[0] == (0, 0)
+    assert len(index.checkpoints) > 1
+    # Checkpoints are at least span apart and strictly increasing.
+    for (prev_c, prev_u), (next_c, next_u) in zip(index.checkpoints,
+                                                  index.checkpoints[1:]):
+        assert next_c > prev_c
+        assert next_u - prev_u >= 32 * 1024
+
+
+def test_build_index_single_member():
+    compressed = gzip.compress(DATA)
+    index = igzip_index.GzipIndex.build(io.BytesIO(compressed))
+    assert index.checkpoints == [(0, 0)]
+    assert index.uncompressed_size == len(DATA)
+
+
+def test_build_index_truncated():
+    with pytest.raises(EOFError):
+        igzip_index.GzipIndex.build(io.BytesIO(MULTI_MEMBER[:-20]))
+
+
+def test_index_save_load(tmp_path):
+    index = igzip_index.GzipIndex.build(io.BytesIO(MULTI_MEMBER),
+                                        span=32 * 1024)
+    index_file = tmp_path / "test.gz.gzi"
+    index.save(index_file)
+    loaded = igzip_index.GzipIndex.load(index_file)
+    assert loaded.checkpoints == index.checkpoints
+    assert loaded.uncompressed_size == index.uncompressed_size
+    assert loaded.compressed_size == index.compressed_size
+
+
+def test_index_load_bad_magic(tmp_path):
+    index_file = tmp_path / "bogus.gzi"
+    index_file.write_bytes(b"NOTANIDX" + b"\x00" * 24)
+    with pytest.raises(ValueError):
+        igzip_index.GzipIndex.load(index_file)
+
+
+@pytest.mark.parametrize("position", [0, 1, MEMBER_SIZE - 1, MEMBER_SIZE,
+                                      5 * MEMBER_SIZE + 42,
+                                      len(DATA) - 1, len(DATA)])
+def test_seek_and_read(position):
+    with igzip_index.open(io.BytesIO(MULTI_MEMBER)) as reader:
+        reader.seek(position)
+        assert reader.read(128) == DATA[position:position + 128]
+
+
+def test_seek_backwards():
+    with igzip_index.open(io.BytesIO(MULTI_MEMBER)) as reader:
+        reader.read(5 * MEMBER_SIZE)
+        reader.seek(MEMBER_SIZE + 100)
+        assert reader.read(50) == DATA[MEMBER_SIZE + 100:MEMBER_SIZE + 150]
+
+
+def test_seek_end():
+    with igzip_index.open(io.BytesIO(MULTI_MEMBER)) as reader:
+        reader.seek(-100, io.SEEK_END)
+        assert reader.read() == DATA[-100:]
+
+
+def test_open_with_prebuilt_index(tmp_path):
+    gzip_file = tmp_path / "test.gz"
+    gzip_file.write_bytes(MULTI_MEMBER)
+    index = igzip_index.GzipIndex.from_file(gzip_file, span=32 * 1024)
+    with igzip_index.open(gzip_file, index=index) as reader:
+        reader.seek(10 * MEMBER_SIZE)
+        assert reader.read(100) == DATA[10 * MEMBER_SIZE:
+                                        10 * MEMBER_SIZE + 100]
+
+
+def test_open_write_mode_fails():
+    with pytest.raises(ValueError):
+        igzip_index.open(io.BytesIO(), "wb")
+
+
+def test_full_read_matches():
+    with igzip_index.open(io.BytesIO(MULTI_MEMBER)) as reader:
+        assert reader.read() == DATA
@@ -18,10 +18,13 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
+import gzip
 import itertools
+import os
+import zlib
 from typing import NamedTuple
 
-from isal import igzip_lib
+from isal import igzip_lib, isal_zlib
 from isal.igzip_lib import (
     COMP_DEFLATE, COMP_GZIP, COMP_GZIP_NO_HDR, COMP_ZLIB, COMP_ZLIB_NO_HDR,
     DECOMP_DEFLATE, DECOMP_GZIP, DECOMP_GZIP_NO_HDR, DECOMP_GZIP_NO_HDR_VER,
@@ -63,3 +66,545 @@ def test_compress_decompress(level, flag: Flag, mem_level, hist_bits):
     comp = igzip_lib.compress(DATA, level, flag.comp, mem_level, hist_bits)
     decomp = igzip_lib.decompress(comp, flag.decomp, hist_bits)
     assert decomp == DATA
+
+
+class TestIgzipDecompressor:
+    def test_decompress(self):
+        compressed = igzip_lib.compress(DATA)
+        decompressor = igzip_lib.IgzipDecompressor()
+        assert decompressor.decompress(compressed) == DATA
+        assert decompressor.eof
+        assert decompressor.unused_data == b""
+
+    @pytest.mark.parametrize("flag", FLAGS)
+    def test_decompress_flags(self, flag: Flag):
+        compressed = igzip_lib.compress(DATA, flag=flag.comp)
+        decompressor = igzip_lib.IgzipDecompressor(flag=flag.decomp)
+        assert decompressor.decompress(compressed) == DATA
+
+    def test_decompress_max_length(self):
+        compressed = igzip_lib.compress(DATA)
+        decompressor = igzip_lib.IgzipDecompressor()
+        chunks = []
+        chunks.append(decompressor.decompress(compressed, 1000))
+        assert len(chunks[0]) == 1000
+        while not decompressor.eof:
+            # needs_input turns True once the retained input runs out,
+            # even while internal output is still pending; feeding b""
+            # keeps draining either way.
+            chunks.append(decompressor.decompress(b"", 1000))
+        assert b"".join(chunks) == DATA
+
+    def test_decompress_chunked_input(self):
+        compressed = igzip_lib.compress(DATA)
+        decompressor = igzip_lib.IgzipDecompressor()
+        chunks = []
+        for i in range(0, len(compressed), 333):
+            assert decompressor.needs_input
+            chunks.append(decompressor.decompress(compressed[i:i + 333]))
+        assert b"".join(chunks) == DATA
+        assert decompressor.eof
+
+    def test_decompress_after_eof(self):
+        compressed = igzip_lib.compress(DATA)
+        decompressor = igzip_lib.IgzipDecompressor()
+        decompressor.decompress(compressed)
+        with pytest.raises(EOFError):
+            decompressor.decompress(b"")
+
+    def test_unused_data(self):
+        compressed = igzip_lib.compress(DATA)
+        decompressor = igzip_lib.IgzipDecompressor()
+        decomp = decompressor.decompress(compressed + b"unused")
+        assert decomp == DATA
+        assert decompressor.eof
+        assert decompressor.unused_data == b"unused"
+
+    def test_decompress_gzip_trailer_verification(self):
+        compressed = bytearray(igzip_lib.compress(DATA,
+                                                  flag=COMP_GZIP))
+        compressed[-5] ^= 0xFF  # Corrupt the crc32 in the gzip trailer.
+        decompressor = igzip_lib.IgzipDecompressor(flag=DECOMP_GZIP)
+        with pytest.raises(igzip_lib.IsalError) as error:
+            decompressor.decompress(bytes(compressed))
+        error.match("checksum")
+
+    def test_decompress_truncated(self):
+        compressed = igzip_lib.compress(DATA)
+        decompressor = igzip_lib.IgzipDecompressor()
+        decompressor.decompress(compressed[:200])
+        assert not decompressor.eof
+        assert decompressor.needs_input
+
+    def test_decompress_zdict(self):
+        zdict = DATA[:4096]
+        # A raw deflate block can use a dictionary.
+        compressobj = zlib.compressobj(wbits=-15, zdict=zdict)
+        compressed = compressobj.compress(DATA) + compressobj.flush()
+        decompressor = igzip_lib.IgzipDecompressor(zdict=zdict)
+        assert decompressor.decompress(compressed) == DATA
+
+    def test_decompress_crc(self):
+        compressed = igzip_lib.compress(DATA, flag=COMP_GZIP)
+        decompressor = igzip_lib.IgzipDecompressor(flag=DECOMP_GZIP)
+        decompressor.decompress(compressed)
+        assert decompressor.crc == zlib.crc32(DATA)
+
+
+class TestCompressInto:
+    def test_roundtrip(self):
+        out = bytearray(len(DATA) + 1024)
+        compressed_size = igzip_lib.compress_into(DATA, out)
+        assert compressed_size > 0
+        decompressed = igzip_lib.decompress(bytes(out[:compressed_size]))
+        assert decompressed == DATA
+
+    @pytest.mark.parametrize("flag", FLAGS)
+    def test_roundtrip_flags_into(self, flag: Flag):
+        out = bytearray(len(DATA) + 1024)
+        compressed_size = igzip_lib.compress_into(DATA, out, flag=flag.comp)
+        decomp_out = bytearray(len(DATA))
+        decompressed_size = igzip_lib.decompress_into(
+            out[:compressed_size], decomp_out, flag=flag.decomp)
+        assert decompressed_size == len(DATA)
+        assert decomp_out == DATA
+
+    def test_output_too_small(self):
+        out = bytearray(64)
+        with pytest.raises(igzip_lib.IsalError) as error:
+            igzip_lib.compress_into(DATA, out)
+        error.match("output buffer")
+
+    def test_output_not_writable(self):
+        with pytest.raises((BufferError, TypeError)):
+            igzip_lib.compress_into(DATA, b"0" * (len(DATA) + 1024))
+
+    def test_memoryview_output(self):
+        out = bytearray(len(DATA) + 1024)
+        compressed_size = igzip_lib.compress_into(DATA, memoryview(out))
+        assert igzip_lib.decompress(out[:compressed_size]) == DATA
+
+
+class TestDecompressInto:
+    def test_exact_size_output(self):
+        compressed = igzip_lib.compress(DATA)
+        out = bytearray(len(DATA))
+        decompressed_size = igzip_lib.decompress_into(compressed, out)
+        assert decompressed_size == len(DATA)
+        assert out == DATA
+
+    def test_oversized_output(self):
+        compressed = igzip_lib.compress(DATA)
+        out = bytearray(2 * len(DATA))
+        decompressed_size = igzip_lib.decompress_into(compressed, out)
+        assert decompressed_size == len(DATA)
+        assert out[:decompressed_size] == DATA
+
+    def test_output_too_small(self):
+        compressed = igzip_lib.compress(DATA)
+        out = bytearray(len(DATA) // 2)
+        with pytest.raises(igzip_lib.IsalError) as error:
+            igzip_lib.decompress_into(compressed, out)
+        error.match("output buffer")
+
+    def test_truncated_input(self):
+        compressed = igzip_lib.compress(DATA)
+        out = bytearray(len(DATA))
+        with pytest.raises(igzip_lib.IsalError) as error:
+            igzip_lib.decompress_into(compressed[:100], out)
+        error.match("incomplete or truncated stream")
+
+
+class TestDecompressChunks:
+    def test_roundtrip(self):
+        compressed = igzip_lib.compress(DATA)
+        chunks = igzip_lib.decompress_chunks(compressed,
+                                             chunk_size=16 * 1024)
+        assert b"".join(chunks) == DATA
+        # All chunks except the last are exactly chunk_size.
+        assert all(len(chunk) == 16 * 1024 for chunk in chunks[:-1])
+        assert 0 < len(chunks[-1]) <= 16 * 1024
+
+    def test_exact_multiple(self):
+        data = DATA[:64 * 1024]
+        compressed = igzip_lib.compress(data)
+        chunks = igzip_lib.decompress_chunks(compressed,
+                                             chunk_size=16 * 1024)
+        assert b"".join(chunks) == data
+        assert [len(chunk) for chunk in chunks] == [16 * 1024] * 4
+
+    def test_empty(self):
+        compressed = igzip_lib.compress(b"")
+        assert igzip_lib.decompress_chunks(compressed) == []
+
+    def test_truncated(self):
+        compressed = igzip_lib.compress(DATA)
+        with pytest.raises(igzip_lib.IsalError) as error:
+            igzip_lib.decompress_chunks(compressed[:100])
+        error.match("incomplete or truncated stream")
+
+    def test_invalid_chunk_size(self):
+        with pytest.raises(ValueError):
+            igzip_lib.decompress_chunks(b"", chunk_size=0)
+
+
+class TestPreparedDict:
+    @pytest.mark.parametrize("level", COMPRESS_LEVELS)
+    def test_same_output_as_plain_zdict(self, level):
+        zdict = DATA[:32 * 1024]
+        data = DATA[32 * 1024: 96 * 1024]
+        plain_obj = isal_zlib.compressobj(level, wbits=-15, zdict=zdict)
+        plain = plain_obj.compress(data) + plain_obj.flush()
+        prepared = igzip_lib.PreparedDict(zdict, level=level)
+        prepared_obj = isal_zlib.compressobj(level, wbits=-15,
+                                             zdict=prepared)
+        assert prepared_obj.compress(data) + prepared_obj.flush() == plain
+        decompressor = zlib.decompressobj(wbits=-15, zdict=zdict)
+        assert decompressor.decompress(plain) == data
+
+    def test_level_mismatch(self):
+        prepared = igzip_lib.PreparedDict(DATA[:1024], level=1)
+        with pytest.raises(ValueError) as error:
+            isal_zlib.compressobj(2, zdict=prepared)
+        error.match("level")
+
+    def test_reuse_after_reset(self):
+        zdict = DATA[:8192]
+        data = DATA[8192:16384]
+        prepared = igzip_lib.PreparedDict(zdict)
+        compressobj = isal_zlib.compressobj(wbits=-15, zdict=prepared)
+        first = compressobj.compress(data) + compressobj.flush()
+        compressobj.reset()
+        second = compressobj.compress(data) + compressobj.flush()
+        assert first == second
+
+    def test_invalid_level(self):
+        with pytest.raises(ValueError):
+            igzip_lib.PreparedDict(DATA[:1024], level=42)
+
+    def test_attributes(self):
+        prepared = igzip_lib.PreparedDict(b"abcdefgh", level=1)
+        assert prepared.dictionary == b"abcdefgh"
+        assert prepared.level == 1
+
+
+def test_igzip_decompressor_size_hint():
+    compressed = igzip_lib.compress(DATA)
+    decompressor = igzip_lib.IgzipDecompressor()
+    assert decompressor.decompress(compressed,
+                                   size_hint=len(DATA)) == DATA
+
+
+def test_igzip_decompressor_size_hint_too_small():
+    # A wrong hint only affects performance, not correctness.
+    compressed = igzip_lib.compress(DATA)
+    decompressor = igzip_lib.IgzipDecompressor()
+    assert decompressor.decompress(compressed, size_hint=7) == DATA
+
+
+class TestHuffmanTables:
+    def test_trained_tables_roundtrip(self):
+        tables = igzip_lib.train_hufftables(DATA)
+        compressed = igzip_lib.compress(DATA, level=0, hufftables=tables)
+        assert igzip_lib.decompress(compressed) == DATA
+
+    def test_trained_tables_improve_ratio(self):
+        # FASTQ-like data is heavily skewed, so tables trained on it must
+        # beat the generic static tables at level 0.
+        tables = igzip_lib.train_hufftables(DATA)
+        trained = igzip_lib.compress(DATA, level=0, hufftables=tables)
+        untrained = igzip_lib.compress(DATA, level=0)
+        assert len(trained) < len(untrained)
+
+    def test_tables_reusable(self):
+        tables = igzip_lib.train_hufftables(DATA[:64 * 1024])
+        first = igzip_lib.compress(DATA, level=0, hufftables=tables)
+        second = igzip_lib.compress(DATA, level=0, hufftables=tables)
+        assert first == second
+
+    def test_compressobj_with_tables(self):
+        tables = igzip_lib.train_hufftables(DATA)
+        compressobj = isal_zlib.compressobj(0, wbits=-15, hufftables=tables)
+        compressed = compressobj.compress(DATA) + compressobj.flush()
+        assert zlib.decompress(compressed, wbits=-15) == DATA
+
+    def test_invalid_hufftables_type(self):
+        with pytest.raises(TypeError):
+            igzip_lib.compress(DATA, level=0, hufftables=b"not tables")
+
+
+class TestStateless:
+    @pytest.mark.parametrize(["level", "flag"],
+                             itertools.product(COMPRESS_LEVELS, FLAGS))
+    def test_roundtrip_stateless(self, level, flag: Flag):
+        small = DATA[:4096]
+        compressed = igzip_lib.compress_stateless(small, level,
+                                                  flag=flag.comp)
+        assert igzip_lib.decompress(compressed, flag.decomp) == small
+
+    def test_compress_stateless_into(self):
+        small = DATA[:4096]
+        out = bytearray(8192)
+        length = igzip_lib.compress_stateless(small, out=out)
+        assert igzip_lib.decompress(bytes(out[:length])) == small
+
+    def test_decompress_stateless(self):
+        small = DATA[:4096]
+        compressed = igzip_lib.compress(small)
+        result = igzip_lib.decompress_stateless(compressed,
+                                                bufsize=len(small))
+        assert result == small
+
+    def test_decompress_stateless_into(self):
+        small = DATA[:4096]
+        compressed = igzip_lib.compress(small)
+        out = bytearray(len(small))
+        length = igzip_lib.decompress_stateless(compressed, out=out)
+        assert length == len(small)
+        assert out == small
+
+    def test_decompress_stateless_bufsize_too_small(self):
+        compressed = igzip_lib.compress(DATA[:4096])
+        with pytest.raises(igzip_lib.IsalError) as error:
+            igzip_lib.decompress_stateless(compressed, bufsize=10)
+        error.match("output buffer")
+
+    def test_decompress_stateless_truncated(self):
+        compressed = igzip_lib.compress(DATA[:4096])
+        with pytest.raises(igzip_lib.IsalError) as error:
+            igzip_lib.decompress_stateless(compressed[:10],
+                                           bufsize=4096)
+        error.match("incomplete or truncated")
+
+    def test_compress_stateless_empty(self):
+        compressed = igzip_lib.compress_stateless(b"")
+        assert igzip_lib.decompress(compressed) == b""
+
+
+class TestDecompressMembers:
+    def test_single_member(self):
+        compressed = igzip_lib.compress(DATA, flag=COMP_GZIP)
+        assert igzip_lib.decompress_members(compressed) == DATA
+
+    def test_many_small_members(self):
+        members = [DATA[i:i + 512] for i in range(0, 64 * 1024, 512)]
+        compressed = b"".join(
+            igzip_lib.compress(member, flag=COMP_GZIP)
+            for member in members)
+        assert igzip_lib.decompress_members(compressed) == b"".join(members)
+
+    def test_members_with_zero_padding(self):
+        compressed = (igzip_lib.compress(DATA[:1000], flag=COMP_GZIP) +
+                      b"\x00" * 100 +
+                      igzip_lib.compress(DATA[1000:2000], flag=COMP_GZIP) +
+                      b"\x00" * 7)
+        assert igzip_lib.decompress_members(compressed) == DATA[:2000]
+
+    def test_truncated(self):
+        compressed = igzip_lib.compress(DATA, flag=COMP_GZIP)
+        with pytest.raises(igzip_lib.IsalError) as error:
+            igzip_lib.decompress_members(compressed[:-5])
+        error.match("incomplete or truncated stream")
+
+    def test_corrupt_checksum(self):
+        compressed = bytearray(igzip_lib.compress(DATA, flag=COMP_GZIP))
+        compressed[-5] ^= 0xFF
+        with pytest.raises(igzip_lib.IsalError) as error:
+            igzip_lib.decompress_members(bytes(compressed))
+        error.match("checksum")
+
+    def test_trailing_garbage(self):
+        compressed = igzip_lib.compress(DATA[:100], flag=COMP_GZIP)
+        with pytest.raises(igzip_lib.IsalError):
+            igzip_lib.decompress_members(compressed + b"garbage")
+
+
+class TestFileToFile:
+    def test_compress_decompress_file(self, tmp_path):
+        source = tmp_path / "data.bin"
+        compressed = tmp_path / "data.bin.gz"
+        restored = tmp_path / "restored.bin"
+        source.write_bytes(DATA)
+        with open(source, "rb") as src, open(compressed, "wb") as dst:
+            written = igzip_lib.compress_file(src, dst)
+        assert written == compressed.stat().st_size
+        assert gzip.decompress(compressed.read_bytes()) == DATA
+        with open(compressed, "rb") as src, open(restored, "wb") as dst:
+            produced = igzip_lib.decompress_file(src, dst)
+        assert produced == len(DATA)
+        assert restored.read_bytes() == DATA
+
+    def test_raw_file_descriptors(self, tmp_path):
+        source = tmp_path / "data.bin"
+        compressed = tmp_path / "data.bin.gz"
+        source.write_bytes(DATA)
+        src_fd = os.open(source, os.O_RDONLY)
+        dst_fd = os.open(compressed, os.O_WRONLY | os.O_CREAT)
+        try:
+            igzip_lib.compress_file(src_fd, dst_fd)
+        finally:
+            os.close(src_fd)
+            os.close(dst_fd)
+        assert gzip.decompress(compressed.read_bytes()) == DATA
+
+    def test_decompress_file_multi_member(self, tmp_path):
+        compressed = tmp_path / "multi.gz"
+        restored = tmp_path / "restored.bin"
+        compressed.write_bytes(
+            igzip_lib.compress(DATA[:1000], flag=COMP_GZIP) +
+            igzip_lib.compress(DATA[1000:2000], flag=COMP_GZIP))
+        with open(compressed, "rb") as src, open(restored, "wb") as dst:
+            igzip_lib.decompress_file(src, dst)
+        assert restored.read_bytes() == DATA[:2000]
+
+    def test_decompress_file_truncated(self, tmp_path):
+        compressed = tmp_path / "trunc.gz"
+        compressed.write_bytes(
+            igzip_lib.compress(DATA, flag=COMP_GZIP)[:-8])
+        with open(compressed, "rb") as src, open(os.devnull, "wb") as dst:
+            with pytest.raises(igzip_lib.IsalError):
+                igzip_lib.decompress_file(src, dst)
+
+    def test_small_block_size(self, tmp_path):
+        source = tmp_path / "data.bin"
+        compressed = tmp_path / "data.bin.gz"
+        source.write_bytes(DATA)
+        with open(source, "rb") as src, open(compressed, "wb") as dst:
+            igzip_lib.compress_file(src, dst, block_size=1024)
+        assert gzip.decompress(compressed.read_bytes()) == DATA
+
+
+class TestBatch:
+    def test_compress_decompress_batch(self):
+        records = [DATA[i:i + 300] for i in range(0, 30000, 300)]
+        compressed = igzip_lib.compress_batch(records)
+        assert compressed == [igzip_lib.compress(record)
+                              for record in records]
+        decompressed = igzip_lib.decompress_batch(compressed)
+        assert decompressed == records
+
+    @pytest.mark.parametrize("flag", FLAGS)
+    def test_batch_flags(self, flag: Flag):
+        records = [DATA[i:i + 1000] for i in range(0, 10000, 1000)]
+        compressed = igzip_lib.compress_batch(records, flag=flag.comp)
+        decompressed = igzip_lib.decompress_batch(compressed,
+                                                  flag=flag.decomp)
+        assert decompressed == records
+
+    def test_empty_batch(self):
+        assert igzip_lib.compress_batch([]) == []
+        assert igzip_lib.decompress_batch([]) == []
+
+    def test_batch_with_empty_record(self):
+        records = [b"", DATA[:100], b""]
+        compressed = igzip_lib.compress_batch(records)
+        assert igzip_lib.decompress_batch(compressed) == records
+
+    def test_decompress_batch_corrupt_record(self):
+        records = [DATA[:1000], DATA[1000:2000]]
+        compressed = igzip_lib.compress_batch(records)
+        compressed[1] = compressed[1][:10]
+        with pytest.raises(igzip_lib.IsalError):
+            igzip_lib.decompress_batch(compressed)
+
+
+def test_compress_invalid_mem_level():
+    with pytest.raises(ValueError) as error:
+        igzip_lib.compress(DATA, mem_level=42)
+    error.match("memory level")
+
+
+def test_compress_invalid_level():
+    with pytest.raises(ValueError) as error:
+        igzip_lib.compress(DATA, level=42)
+    error.match("compression level")
+
+
+def test_compressobj_invalid_mem_level():
+    with pytest.raises(ValueError) as error:
+        isal_zlib.compressobj(memLevel=42)
+    error.match("memory level")
+
+
+@pytest.mark.parametrize("mem_level", MEM_LEVELS)
+def test_compress_honors_mem_level(mem_level):
+    # All memory levels must produce a decompressible stream.
+    compressed = igzip_lib.compress(DATA, mem_level=mem_level)
+    assert igzip_lib.decompress(compressed) == DATA
+
+
+class TestIgzipDecompressorInto:
+    def test_decompress_into(self):
+        compressed = igzip_lib.compress(DATA)
+        decompressor = igzip_lib.IgzipDecompressor()
+        out = bytearray(len(DATA))
+        written = decompressor.decompress_into(compressed, out)
+        assert written == len(DATA)
+        assert out == DATA
+        assert decompressor.eof
+
+    def test_decompress_into_small_buffer(self):
+        compressed = igzip_lib.compress(DATA)
+        decompressor = igzip_lib.IgzipDecompressor()
+        out = bytearray(1000)
+        chunks = []
+        written = decompressor.decompress_into(compressed, out)
+        chunks.append(bytes(out[:written]))
+        while not decompressor.eof:
+            # needs_input turns True once the retained input runs out,
+            # even while internal output is still pending; feeding b""
+            # keeps draining either way.
+            written = decompressor.decompress_into(b"", out)
+            chunks.append(bytes(out[:written]))
+        assert b"".join(chunks) == DATA
+
+    def test_decompress_into_matches_decompress(self):
+        compressed = igzip_lib.compress(DATA)
+        decomp_a = igzip_lib.IgzipDecompressor()
+        decomp_b = igzip_lib.IgzipDecompressor()
+        out = bytearray(4096)
+        written = decomp_b.decompress_into(compressed, out)
+        assert decomp_a.decompress(compressed, 4096) == out[:written]
+        assert decomp_a.needs_input == decomp_b.needs_input
+
+    def test_decompress_into_unused_data(self):
+        compressed = igzip_lib.compress(DATA[:1000]) + b"trailing"
+        decompressor = igzip_lib.IgzipDecompressor()
+        out = bytearray(1000)
+        decompressor.decompress_into(compressed, out)
+        assert decompressor.eof
+        assert decompressor.unused_data == b"trailing"
+
+
+@pytest.mark.parametrize("function", ["compress_batch", "compress_stateless"])
+def test_invalid_levels_batch_and_stateless(function):
+    func = getattr(igzip_lib, function)
+    data = [DATA[:100]] if function == "compress_batch" else DATA[:100]
+    with pytest.raises(ValueError) as error:
+        func(data, 42)
+    error.match("compression level")
+    with pytest.raises(ValueError) as error:
+        func(data, mem_level=42)
+    error.match("memory level")
+
+
+def test_invalid_levels_compress_into():
+    out = bytearray(1024)
+    with pytest.raises(ValueError) as error:
+        igzip_lib.compress_into(DATA[:100], out, 42)
+    error.match("compression level")
+    with pytest.raises(ValueError) as error:
+        igzip_lib.compress_into(DATA[:100], out, mem_level=42)
+    error.match("memory level")
+
+
+def test_invalid_levels_compress_file(tmp_path):
+    source = tmp_path / "data.bin"
+    source.write_bytes(DATA[:100])
+    with open(source, "rb") as src, open(os.devnull, "wb") as dst:
+        with pytest.raises(ValueError) as error:
+            igzip_lib.compress_file(src, dst, 42)
+        error.match("compression level")
+        with pytest.raises(ValueError) as error:
+            igzip_lib.compress_file(src, dst, mem_level=42)
+        error.match("memory level")
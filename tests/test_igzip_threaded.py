@@ -0,0 +1,175 @@
+# Copyright (c) 2020 Leiden University Medical Center
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Tests for the igzip_threaded module."""
+
+import gzip
+import io
+import itertools
+
+from isal import igzip, igzip_threaded
+
+import pytest
+
+from .test_compat import DATA as RAW_DATA
+
+DATA = RAW_DATA[:256 * 1024]
+
+
+@pytest.mark.parametrize(["threads", "level"],
+                         itertools.product([1, 2, 4], [0, 1, 2, 3]))
+def test_threaded_write_roundtrip(threads, level):
+    fileobj = io.BytesIO()
+    with igzip_threaded.ThreadedGzipWriter(
+            fileobj, compresslevel=level, threads=threads,
+            block_size=32 * 1024) as writer:
+        writer.write(DATA)
+    assert gzip.decompress(fileobj.getvalue()) == DATA
+    assert igzip.decompress(fileobj.getvalue()) == DATA
+
+
+def test_threaded_write_not_a_multiple_of_block_size():
+    fileobj = io.BytesIO()
+    with igzip_threaded.ThreadedGzipWriter(
+            fileobj, threads=2, block_size=64 * 1024) as writer:
+        # Write in chunks that do not align with the block size.
+        for i in range(0, len(DATA), 33333):
+            writer.write(DATA[i: i + 33333])
+    assert gzip.decompress(fileobj.getvalue()) == DATA
+
+
+def test_threaded_write_empty():
+    fileobj = io.BytesIO()
+    with igzip_threaded.ThreadedGzipWriter(fileobj, threads=2) as writer:
+        writer.write(b"")
+    assert gzip.decompress(fileobj.getvalue()) == b""
+
+
+def test_threaded_write_flush():
+    fileobj = io.BytesIO()
+    with igzip_threaded.ThreadedGzipWriter(fileobj, threads=2) as writer:
+        writer.write(DATA[:1000])
+        writer.flush()
+        writer.write(DATA[1000:2000])
+    assert gzip.decompress(fileobj.getvalue()) == DATA[:2000]
+
+
+def test_threaded_open_write(tmp_path):
+    test_file = tmp_path / "test.gz"
+    with igzip_threaded.open(test_file, "wb", threads=2) as writer:
+        writer.write(DATA)
+    with igzip.open(test_file, "rb") as reader:
+        assert reader.read() == DATA
+
+
+def test_threaded_open_text_mode(tmp_path):
+    test_file = tmp_path / "test.gz"
+    with igzip_threaded.open(test_file, "wt", threads=2) as writer:
+        writer.write("thread hello")
+    with igzip.open(test_file, "rt") as reader:
+        assert reader.read() == "thread hello"
+
+
+def test_threaded_open_read_single_member():
+    fileobj = io.BytesIO(gzip.compress(DATA))
+    with igzip_threaded.open(fileobj, "rb") as reader:
+        assert reader.read() == DATA
+
+
+@pytest.mark.parametrize("threads", [1, 2, 4])
+def test_threaded_read_multi_member(threads):
+    members = [DATA[i: i + 4096] for i in range(0, len(DATA), 4096)]
+    compressed = b"".join(gzip.compress(member) for member in members)
+    fileobj = io.BytesIO(compressed)
+    with igzip_threaded.open(fileobj, "rb", threads=threads) as reader:
+        assert reader.read() == DATA
+
+
+def test_threaded_read_small_block_size():
+    compressed = b"".join(gzip.compress(DATA[i: i + 1024])
+                          for i in range(0, 64 * 1024, 1024))
+    raw = igzip_threaded.ThreadedGzipReader(
+        io.BytesIO(compressed), threads=2, block_size=512)
+    with io.BufferedReader(raw) as reader:
+        assert reader.read() == DATA[:64 * 1024]
+
+
+def test_threaded_read_empty_members():
+    compressed = (gzip.compress(b"") + gzip.compress(DATA[:1000]) +
+                  gzip.compress(b""))
+    raw = igzip_threaded.ThreadedGzipReader(io.BytesIO(compressed), threads=2)
+    with io.BufferedReader(raw) as reader:
+        assert reader.read() == DATA[:1000]
+
+
+def test_threaded_read_corrupt_member():
+    compressed = bytearray(b"".join(gzip.compress(DATA[i: i + 4096])
+                           for i in range(0, len(DATA), 4096)))
+    compressed[len(compressed) // 2] ^= 0xFF
+    raw = igzip_threaded.ThreadedGzipReader(
+        io.BytesIO(bytes(compressed)), threads=2, block_size=4096)
+    with pytest.raises((igzip.BadGzipFile, EOFError, OSError)):
+        with io.BufferedReader(raw) as reader:
+            reader.read()
+
+
+def test_threaded_read_roundtrip_with_threaded_writer():
+    fileobj = io.BytesIO()
+    with igzip_threaded.ThreadedGzipWriter(fileobj, threads=2) as writer:
+        writer.write(DATA)
+    fileobj.seek(0)
+    with igzip_threaded.open(fileobj, "rb", threads=2) as reader:
+        assert reader.read() == DATA
+
+
+def test_threaded_reader_invalid_threads():
+    with pytest.raises(ValueError) as error:
+        igzip_threaded.ThreadedGzipReader(io.BytesIO(), threads=0)
+    error.match("threads")
+
+
+def test_threaded_write_error_propagates():
+    fileobj = io.BytesIO()
+    writer = igzip_threaded.ThreadedGzipWriter(fileobj, threads=2)
+    # Patch the raw file with one that errors to check that write errors in
+    # the output thread eventually reach the caller.
+    writer.raw = None
+    with pytest.raises(Exception):
+        writer.write(DATA)
+        writer.close()
+
+
+@pytest.mark.parametrize("mode", ["rbt", "wbt"])
+def test_threaded_open_invalid_mode(mode):
+    with pytest.raises(ValueError) as error:
+        igzip_threaded.open(io.BytesIO(), mode)
+    error.match("Invalid mode")
+
+
+def test_threaded_writer_invalid_level():
+    with pytest.raises(ValueError) as error:
+        igzip_threaded.ThreadedGzipWriter(io.BytesIO(), compresslevel=42)
+    error.match("Compression level")
+
+
+def test_threaded_writer_invalid_threads():
+    with pytest.raises(ValueError) as error:
+        igzip_threaded.ThreadedGzipWriter(io.BytesIO(), threads=0)
+    error.match("threads")
